@@ -0,0 +1,399 @@
+// Throughput benchmarks: every mutation operator, log records, coverage bitmap
+// classification, the corpus store, the seed scheduler and end-to-end execs/s of every
+// executor mode. All
+// inputs come from fixed seeds and the results are written as JSON, so runs of different
+// builds can be compared.
+//
+// Build (from the repository root):
+//   g++ -std=c++17 -O2 -o fuzzer_bench bench/fuzzer_bench.cpp -lpthread -lstdc++fs
+// Run:
+//   ./fuzzer_bench --trivial ./trivial_target --jpeg ./jpeg_target --seed targets/seed.jpg
+//                  --runtime ./forkserver_rt.so --out bench.json
+//                  [--jpeg-lib ./jpeg_target.so --host ./harness_host]
+// The execs/s benchmarks are skipped for targets that are not given.
+#define FUZZER_HEADLESS
+#include "../project.cpp"
+
+namespace {
+
+constexpr uint64_t BENCH_SEED = 0x5eed5eed;
+constexpr size_t MUTATION_INPUT_SIZE = 4096;
+constexpr int MUTATION_BATCH = 1024;
+
+struct bench_result {
+    std::string name;
+    std::string unit;
+    double value;
+    long long iterations;
+};
+
+class bench_runner {
+    double minSeconds;
+    std::string filter;
+    std::vector<bench_result> results;
+public:
+    bench_runner(double s, const std::string& f) : minSeconds(s), filter(f) {};
+    bool wanted(const std::string& name) const {
+        return filter.empty() || name.find(filter) != std::string::npos;
+    }
+    void add(const std::string& name, const std::string& unit, double value, long long iterations) {
+        results.push_back({ name, unit, value, iterations });
+        std::cerr << name << ": " << static_cast<long long>(value) << " " << unit << std::endl;
+    }
+    // Calls fn once to warm up, then until minSeconds have passed; fn returns the units of
+    // work it did and the result is their rate.
+    template <class Fn>
+    void measure(const std::string& name, const std::string& unit, Fn fn) {
+        if (!wanted(name))
+            return;
+        fn();
+        double work = 0;
+        long long iterations = 0;
+        auto start = std::chrono::steady_clock::now();
+        double seconds;
+        do {
+            work += fn();
+            ++iterations;
+            seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+        } while (seconds < minSeconds);
+        add(name, unit, work / seconds, iterations);
+    }
+    double seconds() const {
+        return minSeconds;
+    }
+    bool write(std::ostream& out) const {
+        out << "{\n  \"schema\": 1,\n  \"seed\": " << BENCH_SEED << ",\n  \"time\": " << std::time(nullptr)
+            << ",\n  \"threads\": " << std::thread::hardware_concurrency() << ",\n  \"mutation_input_bytes\": " << MUTATION_INPUT_SIZE
+            << ",\n  \"results\": [\n";
+        char value[32];
+        for (size_t i = 0; i < results.size(); ++i) {
+            std::snprintf(value, sizeof(value), "%.6g", results[i].value);
+            out << "    { \"name\": \"" << results[i].name << "\", \"unit\": \"" << results[i].unit << "\", \"value\": " << value
+                << ", \"iterations\": " << results[i].iterations << " }" << (i + 1 < results.size() ? ",\n" : "\n");
+        }
+        out << "  ]\n}\n";
+        return static_cast<bool>(out);
+    }
+};
+
+std::vector<unsigned char> randomBytes(size_t n, uint64_t seed) {
+    wyrand rng(seed);
+    std::vector<unsigned char> bytes(n);
+    for (unsigned char& b : bytes)
+        b = static_cast<unsigned char>(rng());
+    return bytes;
+}
+
+void benchMutations(bench_runner& runner, const std::vector<unsigned char>& jpeg) {
+    static const char* const names[] = { "flip_bit", "flip_bytes", "flip_run", "arith8", "arith16", "arith32", "interesting8",
+        "interesting16", "interesting32", "random_byte", "copy_block", "insert_block", "delete_block", "duplicate_block", "splice", "dictionary" };
+    const std::vector<unsigned char> donor = randomBytes(MUTATION_INPUT_SIZE, BENCH_SEED + 1);
+    // Half of the tokens have a match in the input, as harvested comparisons would.
+    token_list tokens;
+    {
+        const std::vector<unsigned char> input = randomBytes(MUTATION_INPUT_SIZE, BENCH_SEED);
+        const std::vector<unsigned char> values = randomBytes(4 * 64, BENCH_SEED + 2);
+        for (size_t k = 0; k < 64; ++k) {
+            dictionary_token token;
+            token.value.assign(values.begin() + 4 * k, values.begin() + 4 * k + 4);
+            if (k % 2)
+                token.match.assign(input.begin() + 61 * k, input.begin() + 61 * k + 4);
+            tokens.push_back(std::move(token));
+        }
+    }
+    for (int which = 0; which < mutation_kernels::ALL_OPS; ++which) {
+        std::vector<unsigned char> buffer = randomBytes(MUTATION_INPUT_SIZE, BENCH_SEED);
+        wyrand rng(BENCH_SEED);
+        mutation_kernels::op op = static_cast<mutation_kernels::op>(which);
+        // Resizing operators are followed by a resize back, so every call sees the same size.
+        runner.measure(std::string("mutate.") + names[which], "bytes/s", [&] {
+            for (int k = 0; k < MUTATION_BATCH; ++k) {
+                switch (op) {
+                case mutation_kernels::INSERT_BLOCK: mutation_kernels::insertBlock(buffer, 0, buffer.size(), rng); break;
+                case mutation_kernels::DELETE_BLOCK: mutation_kernels::deleteBlock(buffer, 0, buffer.size(), rng); break;
+                case mutation_kernels::DUPLICATE_BLOCK: mutation_kernels::duplicateBlock(buffer, 0, buffer.size(), rng); break;
+                case mutation_kernels::SPLICE: mutation_kernels::splice(buffer, donor, rng); break;
+                case mutation_kernels::DICTIONARY: mutation_kernels::putToken(buffer, 0, buffer.size(), tokens[rng.below(tokens.size())], rng); break;
+                default: mutation_kernels::mutateInPlace(buffer.data(), buffer.size(), rng, op); break;
+                }
+                buffer.resize(MUTATION_INPUT_SIZE);
+            }
+            return static_cast<double>(MUTATION_BATCH) * MUTATION_INPUT_SIZE;
+            });
+    }
+
+    jpgManager engine;
+    engine.setSeed(BENCH_SEED);
+    engine.setMC(16);
+    const std::vector<unsigned char> raw = randomBytes(MUTATION_INPUT_SIZE, BENCH_SEED);
+    runner.measure("mutate.havoc16", "bytes/s", [&] {
+        for (int k = 0; k < MUTATION_BATCH; ++k)
+            engine.mutateFrom(raw, donor);
+        return static_cast<double>(MUTATION_BATCH) * raw.size();
+        });
+    if (jpeg.empty())
+        return;
+    jpeg_index index = jpeg_index::parse(jpeg);
+    runner.measure("mutate.jpeg_structured", "bytes/s", [&] {
+        for (int k = 0; k < MUTATION_BATCH; ++k)
+            engine.mutateFrom(jpeg, index, jpeg, &index);
+        return static_cast<double>(MUTATION_BATCH) * jpeg.size();
+        });
+    runner.measure("jpeg.parse", "bytes/s", [&] {
+        for (int k = 0; k < MUTATION_BATCH; ++k)
+            index = jpeg_index::parse(jpeg);
+        return static_cast<double>(MUTATION_BATCH) * jpeg.size();
+        });
+}
+
+// The writer thread also prints every record, so stdout is pointed at /dev/null meanwhile.
+void benchLogging(bench_runner& runner) {
+    if (!runner.wanted("log."))
+        return;
+    std::fflush(stdout);
+    int saved = dup(STDOUT_FILENO);
+    int devnull = open("/dev/null", O_WRONLY);
+    dup2(devnull, STDOUT_FILENO);
+    close(devnull);
+
+    log_mask mask = log_category::PROCESS_INFO;
+    unsigned long long droppedBefore = Logger::dropped();
+    long long pushed = 0;
+    auto start = std::chrono::steady_clock::now();
+    double producerSeconds;
+    do {
+        for (int k = 0; k < 256; ++k)
+            Logger::logProcessInfo(mask, "Process exited with code: ", k);
+        pushed += 256;
+        producerSeconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+    } while (producerSeconds < runner.seconds());
+    Logger::flush();
+    double totalSeconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+    long long written = pushed - static_cast<long long>(Logger::dropped() - droppedBefore);
+
+    std::fflush(stdout);
+    dup2(saved, STDOUT_FILENO);
+    close(saved);
+    runner.add("log.push", "records/s", pushed / producerSeconds, pushed);
+    runner.add("log.written", "records/s", written / totalSeconds, written);
+}
+
+void benchCoverage(bench_runner& runner) {
+    coverage_map map;
+    if (!map.valid())
+        return;
+    // A few hundred hit edges with mixed counts, about what one JPEG run leaves behind.
+    uint8_t* trace = const_cast<uint8_t*>(map.data());
+    wyrand rng(BENCH_SEED);
+    auto fill = [&] {
+        map.reset();
+        for (int k = 0; k < 400; ++k)
+            trace[rng.below(MAP_SIZE)] = static_cast<uint8_t>(1 + rng.below(255));
+    };
+    fill();
+    runner.measure("coverage.classify", "bytes/s", [&] {
+        for (int k = 0; k < 64; ++k)
+            map.classify();
+        return 64.0 * MAP_SIZE;
+        });
+    virgin_map virgin;
+    virgin.update(map);
+    runner.measure("coverage.virgin_update", "bytes/s", [&] {
+        for (int k = 0; k < 64; ++k)
+            virgin.update(map);
+        return 64.0 * MAP_SIZE;
+        });
+    runner.measure("coverage.path_hash", "bytes/s", [&] {
+        for (int k = 0; k < 64; ++k)
+            map.pathHash();
+        return 64.0 * MAP_SIZE;
+        });
+}
+
+void benchCorpus(bench_runner& runner, const fs::path& scratch) {
+    constexpr int ENTRIES = 4096;
+    std::vector<std::vector<unsigned char>> inputs;
+    for (int k = 0; k < ENTRIES; ++k)
+        inputs.push_back(randomBytes(1024, BENCH_SEED + k));
+    int round = 0;
+    // Every round inserts into a fresh store, so inserts always append.
+    runner.measure("corpus.insert", "inputs/s", [&] {
+        fs::path dir = scratch / ("corpus" + std::to_string(round++));
+        corpus_store corpus(dir.string());
+        corpus.load();
+        for (const auto& input : inputs)
+            corpus.add(input);
+        return static_cast<double>(ENTRIES);
+        });
+
+    corpus_store corpus((scratch / "corpus-lookup").string());
+    corpus.load();
+    for (const auto& input : inputs)
+        corpus.add(input);
+    runner.measure("corpus.lookup", "inputs/s", [&] {
+        for (const auto& input : inputs)
+            corpus.add(input);
+        return static_cast<double>(ENTRIES);
+        });
+    wyrand rng(BENCH_SEED);
+    volatile unsigned char sink = 0;
+    runner.measure("corpus.view", "inputs/s", [&] {
+        for (int k = 0; k < ENTRIES; ++k)
+            sink = corpus.view(static_cast<uint32_t>(rng.below(ENTRIES)))[0];
+        return static_cast<double>(ENTRIES);
+        });
+    runner.measure("corpus.load", "inputs/s", [&] {
+        corpus_store reopened((scratch / "corpus-lookup").string());
+        reopened.load();
+        return static_cast<double>(reopened.size());
+        });
+}
+
+// Picks from a queue of 100k entries with spread exec times, sizes and path counts. Every
+// pick also counts a path, as the exec loop does, so the table keeps being rebuilt.
+void benchScheduler(bench_runner& runner) {
+    constexpr uint32_t ENTRIES = 100000;
+    for (power_schedule schedule : { power_schedule::EXPLORE, power_schedule::FAST, power_schedule::RARE }) {
+        std::string name = std::string("schedule.pick100k.") + scheduleName(schedule);
+        if (!runner.wanted(name))
+            continue;
+        seed_scheduler scheduler(schedule);
+        wyrand rng(BENCH_SEED);
+        std::vector<uint64_t> paths(ENTRIES);
+        for (uint64_t& path : paths) {
+            path = rng();
+            scheduler.add(static_cast<uint32_t>(50 + rng.below(5000)), 64 + rng.below(8192), path);
+        }
+        volatile uint32_t sink = 0;
+        runner.measure(name, "picks/s", [&] {
+            for (int k = 0; k < 4096; ++k) {
+                uint32_t id = scheduler.next(rng);
+                scheduler.countPath(paths[id]);
+                sink = id;
+            }
+            return 4096.0;
+            });
+    }
+}
+
+void benchExecution(bench_runner& runner, const std::string& label, const std::string& target, const std::vector<unsigned char>& input, const std::string& runtime) {
+    if (target.empty())
+        return;
+    for (int forkserver = 0; forkserver < 2; ++forkserver) {
+        std::string name = "exec." + label + (forkserver ? ".forkserver" : ".spawn");
+        if (!runner.wanted(name))
+            continue;
+        scratch_file file("bench");
+        coverage_map coverage;
+        file.write(input);
+        std::unique_ptr<executor> exec;
+        if (forkserver) {
+            std::unique_ptr<forkserver_executor> server(new forkserver_executor(target, file.path(), runtime, coverage.valid() ? &coverage : nullptr));
+            if (!server->start()) {
+                std::cerr << name << ": fork server did not start, skipped" << std::endl;
+                continue;
+            }
+            exec = std::move(server);
+        }
+        else {
+            exec.reset(new spawn_executor(target, file.path(), coverage.valid() ? &coverage : nullptr));
+        }
+        exec->setTimeout(1000);
+        runner.measure(name, "execs/s", [&] {
+            for (int k = 0; k < 16; ++k)
+                exec->run();
+            return 16.0;
+            });
+    }
+}
+
+void benchInprocess(bench_runner& runner, const std::string& label, const std::string& library, const std::vector<unsigned char>& input, const std::string& host, const std::string& runtime) {
+    std::string name = "exec." + label + ".inprocess";
+    if (library.empty() || !runner.wanted(name))
+        return;
+    scratch_file file("bench");
+    coverage_map coverage;
+    file.write(input);
+    inprocess_executor exec(library, file.path(), host, runtime, coverage.valid() ? &coverage : nullptr, log_category::NONE);
+    if (!exec.start()) {
+        std::cerr << name << ": harness host did not start, skipped" << std::endl;
+        return;
+    }
+    exec.setTimeout(1000);
+    runner.measure(name, "execs/s", [&] {
+        for (int k = 0; k < 16; ++k)
+            exec.run();
+        return 16.0;
+        });
+}
+
+std::string absolutePath(const std::string& path) {
+    return path.empty() ? path : fs::absolute(path).string();
+}
+
+}
+
+int main(int argc, char** argv) {
+    std::string trivial, jpegTarget, jpegLibrary, host, seedPath, runtime, out, filter;
+    double seconds = 0.5;
+    for (int i = 1; i + 1 < argc; i += 2) {
+        std::string flag = argv[i];
+        if (flag == "--trivial")
+            trivial = absolutePath(argv[i + 1]);
+        else if (flag == "--jpeg")
+            jpegTarget = absolutePath(argv[i + 1]);
+        else if (flag == "--jpeg-lib")
+            jpegLibrary = absolutePath(argv[i + 1]);
+        else if (flag == "--host")
+            host = absolutePath(argv[i + 1]);
+        else if (flag == "--seed")
+            seedPath = absolutePath(argv[i + 1]);
+        else if (flag == "--runtime")
+            runtime = absolutePath(argv[i + 1]);
+        else if (flag == "--out")
+            out = absolutePath(argv[i + 1]);
+        else if (flag == "--filter")
+            filter = argv[i + 1];
+        else if (flag == "--time")
+            seconds = std::atof(argv[i + 1]);
+        else {
+            std::cerr << "Usage: fuzzer_bench [--trivial PATH] [--jpeg PATH] [--jpeg-lib PATH] [--host PATH] [--seed PATH] [--runtime PATH] [--out FILE] [--filter TEXT] [--time SECONDS]\n";
+            return 2;
+        }
+    }
+    if (runtime.empty())
+        runtime = forkserverRuntimePath();
+    if (host.empty())
+        host = harnessHostPath();
+
+    std::vector<unsigned char> jpeg;
+    if (!seedPath.empty()) {
+        std::ifstream inFile(seedPath, std::ios::binary);
+        jpeg.assign(std::istreambuf_iterator<char>(inFile), std::istreambuf_iterator<char>());
+    }
+
+    // log.txt and the corpus stores go to a scratch directory that is removed at the end.
+    char scratchTemplate[] = "/tmp/fuzzer-bench-XXXXXX";
+    if (!mkdtemp(scratchTemplate) || chdir(scratchTemplate) != 0) {
+        std::cerr << "Failed to create a scratch directory\n";
+        return 1;
+    }
+    fs::path scratch(scratchTemplate);
+
+    bench_runner runner(seconds, filter);
+    benchMutations(runner, jpeg);
+    benchLogging(runner);
+    benchCoverage(runner);
+    benchCorpus(runner, scratch);
+    benchScheduler(runner);
+    benchExecution(runner, "trivial", trivial, jpeg.empty() ? randomBytes(64, BENCH_SEED) : jpeg, runtime);
+    benchExecution(runner, "jpeg", jpegTarget, jpeg.empty() ? randomBytes(64, BENCH_SEED) : jpeg, runtime);
+    benchInprocess(runner, "jpeg", jpegLibrary, jpeg.empty() ? randomBytes(64, BENCH_SEED) : jpeg, host, runtime);
+
+    std::error_code ec;
+    fs::remove_all(scratch, ec);
+    if (out.empty())
+        return runner.write(std::cout) ? 0 : 1;
+    std::ofstream outFile(out);
+    return runner.write(outFile) ? 0 : 1;
+}
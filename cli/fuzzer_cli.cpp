@@ -0,0 +1,29 @@
+// Headless front end for machines without a display: the same campaigns as the GUI, driven
+// from the command line and built without wxWidgets.
+//
+// Build (from the repository root):
+//   g++ -std=c++17 -O2 -o fuzzer_cli cli/fuzzer_cli.cpp -lpthread -lstdc++fs
+// Run:
+//   ./fuzzer_cli -e ./jpeg_target -s targets/seed.jpg -i 100000 -a DUMB -l STD log.txt
+// SIGINT or SIGTERM stops the campaign; crashes, hangs and the corpus found so far are kept.
+#define FUZZER_HEADLESS
+#include "../project.cpp"
+
+namespace {
+
+void onStopSignal(int) {
+    campaign_control::global().requestStop();
+}
+
+}
+
+int main(int argc, char** argv) {
+    struct sigaction action = {};
+    action.sa_handler = onStopSignal;
+    sigemptyset(&action.sa_mask);
+    sigaction(SIGINT, &action, nullptr);
+    sigaction(SIGTERM, &action, nullptr);
+
+    Fuzzer fuzzer;
+    return fuzzer.run(argc, argv);
+}
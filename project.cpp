@@ -1,537 +1,5197 @@
 #define _SILENCE_EXPERIMENTAL_FILESYSTEM_DEPRECATION_WARNING 1;
 #define _CRT_SECURE_NO_WARNINGS 1;
+#ifndef FUZZER_HEADLESS
 #include <wx/spinctrl.h>
 #include <wx/wx.h>
+#endif
 #include <iostream>
 #include <vector>
-#include <windows.h>
 #include <string>
 #include <fstream>
 #include <random>
-#include <locale>
-#include <codecvt>
+#include <memory>
+#include <mutex>
+#include <atomic>
+#include <deque>
+#include <unordered_map>
+#include <unordered_set>
+#include <functional>
+#include <condition_variable>
+#include <algorithm>
+#include <cstring>
+#include <cstdio>
+#include <ctime>
+#include <chrono>
 #include <experimental/filesystem>
 #include <thread>
-#include <regex>
+#include <charconv>
+#include <type_traits>
+#include <elf.h>
+#include <unistd.h>
+#include <fcntl.h>
+#include <poll.h>
+#include <sched.h>
+#include <signal.h>
+#include <spawn.h>
+#include <sys/wait.h>
+#include <sys/file.h>
+#include <sys/mman.h>
+#include <sys/resource.h>
+#include <sys/socket.h>
+#include <sys/stat.h>
+#include <sys/syscall.h>
+#include <sys/timerfd.h>
 
 namespace fs = std::experimental::filesystem;
 
 int crashes_detected;
+int unique_crashes_detected;
+int timeouts_detected;
+int unique_hangs_detected;
 
+enum class log_category : unsigned {
+    NONE = 0,
+    ERROR = 1 << 0,
+    PROCESS_INFO = 1 << 1,
+    UNEXPECTED = 1 << 2,
+    CRASH = 1 << 3
+};
+
+// Set of enabled log categories, resolved once when a campaign starts.
+using log_mask = log_category;
+
+inline log_mask operator|(log_mask a, log_mask b) {
+    return static_cast<log_mask>(static_cast<unsigned>(a) | static_cast<unsigned>(b));
+}
+
+inline log_mask& operator|=(log_mask& a, log_mask b) {
+    return a = a | b;
+}
+
+inline bool enabled(log_mask mask, log_category category) {
+    return (static_cast<unsigned>(mask) & static_cast<unsigned>(category)) != 0;
+}
+
+// Parses a comma-separated list of ERROR, PROCESS_INFO, UNEXPECTED and CRASH.
+static bool parseLogFilter(const std::string& list, log_mask& mask) {
+    log_mask parsed = log_category::NONE;
+    size_t begin = 0;
+    for (;;) {
+        size_t end = list.find(',', begin);
+        std::string name = list.substr(begin, end == std::string::npos ? std::string::npos : end - begin);
+        if (name == "ERROR")
+            parsed |= log_category::ERROR;
+        else if (name == "PROCESS_INFO")
+            parsed |= log_category::PROCESS_INFO;
+        else if (name == "UNEXPECTED")
+            parsed |= log_category::UNEXPECTED;
+        else if (name == "CRASH")
+            parsed |= log_category::CRASH;
+        else
+            return false;
+        if (end == std::string::npos)
+            break;
+        begin = end + 1;
+    }
+    mask = parsed;
+    return true;
+}
+
+// Logs an integer in hexadecimal.
+struct log_hex {
+    uint64_t value;
+};
+
+// Worker threads push fixed-size records into their own single-producer ring; one
+// background thread drains all rings, formats a batch and writes it to the log file,
+// which stays open. A full ring drops the record and counts it instead of blocking.
 class Logger {
-    static void log(const std::string& message) {
-        std::ofstream logFile("log.txt", std::ios::app);
-        if (logFile.is_open()) {
-            auto now = std::chrono::system_clock::now();
-            std::time_t currentTime = std::chrono::system_clock::to_time_t(now);
-            char buffer[80];
-            std::strftime(buffer, sizeof(buffer), "%Y-%m-%d %H:%M:%S", std::localtime(&currentTime));
-            std::cout << "[" << buffer << "] " << message << std::endl;
-            logFile << "[" << buffer << "] " << message << std::endl;
-            logFile.close();
+    struct log_record {
+        long long time;
+        unsigned short length;
+        char text[246];
+    };
+
+    struct log_ring {
+        static constexpr size_t CAPACITY = 1024;
+        alignas(64) std::atomic<size_t> head{ 0 };
+        alignas(64) std::atomic<size_t> tail{ 0 };
+        std::atomic<bool> orphaned{ false };
+        log_record records[CAPACITY];
+    };
+
+    struct backend {
+        std::mutex registryMutex;
+        std::vector<std::shared_ptr<log_ring>> rings;
+        std::atomic<unsigned long long> dropped{ 0 };
+        std::atomic<bool> stopping{ false };
+        std::FILE* file;
+        std::thread writer;
+
+        backend() : file(std::fopen("log.txt", "a")) {
+            writer = std::thread(&backend::writerLoop, this);
+        }
+        ~backend() {
+            stopping = true;
+            writer.join();
+            if (file)
+                std::fclose(file);
+        }
+        std::shared_ptr<log_ring> attach() {
+            std::shared_ptr<log_ring> ring = std::make_shared<log_ring>();
+            std::lock_guard<std::mutex> lock(registryMutex);
+            rings.push_back(ring);
+            return ring;
+        }
+        bool idle() {
+            std::lock_guard<std::mutex> lock(registryMutex);
+            for (const auto& ring : rings)
+                if (ring->head.load(std::memory_order_acquire) != ring->tail.load(std::memory_order_acquire))
+                    return false;
+            return true;
+        }
+        void writerLoop() {
+            std::string batch;
+            std::time_t stampSecond = -1;
+            char stamp[80] = "";
+            unsigned long long reportedDrops = 0;
+            for (;;) {
+                bool last = stopping.load();
+                std::vector<std::shared_ptr<log_ring>> snapshot;
+                {
+                    std::lock_guard<std::mutex> lock(registryMutex);
+                    snapshot = rings;
+                }
+                batch.clear();
+                std::vector<size_t> heads;
+                for (const auto& ring : snapshot) {
+                    size_t head = ring->head.load(std::memory_order_relaxed);
+                    size_t tail = ring->tail.load(std::memory_order_acquire);
+                    for (; head != tail; ++head) {
+                        const log_record& record = ring->records[head % log_ring::CAPACITY];
+                        std::time_t second = static_cast<std::time_t>(record.time / 1000000000);
+                        if (second != stampSecond) {
+                            std::tm local;
+                            localtime_r(&second, &local);
+                            std::strftime(stamp, sizeof(stamp), "%Y-%m-%d %H:%M:%S", &local);
+                            stampSecond = second;
+                        }
+                        batch += '[';
+                        batch += stamp;
+                        batch += "] ";
+                        batch.append(record.text, record.length);
+                        batch += '\n';
+                    }
+                    heads.push_back(head);
+                }
+                unsigned long long drops = dropped.load();
+                if (drops != reportedDrops) {
+                    batch += "[LOGGER] " + std::to_string(drops - reportedDrops) + " messages dropped\n";
+                    reportedDrops = drops;
+                }
+                if (!batch.empty()) {
+                    std::fwrite(batch.data(), 1, batch.size(), stdout);
+                    std::fflush(stdout);
+                    if (file) {
+                        std::fwrite(batch.data(), 1, batch.size(), file);
+                        std::fflush(file);
+                    }
+                }
+                // Slots are released only after their text has been written.
+                for (size_t i = 0; i < snapshot.size(); ++i)
+                    snapshot[i]->head.store(heads[i], std::memory_order_release);
+                {
+                    std::lock_guard<std::mutex> lock(registryMutex);
+                    rings.erase(std::remove_if(rings.begin(), rings.end(), [](const std::shared_ptr<log_ring>& ring) {
+                        return ring->orphaned && ring->head.load() == ring->tail.load();
+                        }), rings.end());
+                }
+                if (last)
+                    return;
+                if (batch.empty())
+                    std::this_thread::sleep_for(std::chrono::milliseconds(5));
+            }
+        }
+    };
+
+    // Marks the ring of an exiting thread so the writer can drop it once it is drained.
+    struct ring_handle {
+        std::shared_ptr<log_ring> ring;
+        ring_handle() : ring(instance().attach()) {};
+        ~ring_handle() {
+            ring->orphaned = true;
+        }
+    };
+
+    static backend& instance() {
+        static backend b;
+        return b;
+    }
+
+    static void append(log_record& record, const char* text, size_t size) {
+        size_t n = std::min(size, sizeof(record.text) - record.length);
+        std::memcpy(record.text + record.length, text, n);
+        record.length += static_cast<unsigned short>(n);
+    }
+    static void append(log_record& record, const char* text) {
+        append(record, text, std::strlen(text));
+    }
+    static void append(log_record& record, const std::string& text) {
+        append(record, text.data(), text.size());
+    }
+    static void append(log_record& record, log_hex value) {
+        char digits[24] = "0x";
+        auto end = std::to_chars(digits + 2, digits + sizeof(digits), value.value, 16).ptr;
+        append(record, digits, end - digits);
+    }
+    template <class T, class = typename std::enable_if<std::is_integral<T>::value>::type>
+    static void append(log_record& record, T value) {
+        char digits[24];
+        auto end = std::to_chars(digits, digits + sizeof(digits), value).ptr;
+        append(record, digits, end - digits);
+    }
+
+    // Formats straight into the ring slot; nothing is built when the ring is full.
+    template <class... Args>
+    static void log(const char* prefix, const Args&... args) {
+        backend& b = instance();
+        thread_local ring_handle handle;
+        log_ring& ring = *handle.ring;
+
+        size_t tail = ring.tail.load(std::memory_order_relaxed);
+        if (tail - ring.head.load(std::memory_order_acquire) >= log_ring::CAPACITY) {
+            b.dropped.fetch_add(1, std::memory_order_relaxed);
+            return;
         }
+        log_record& record = ring.records[tail % log_ring::CAPACITY];
+        record.time = std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::system_clock::now().time_since_epoch()).count();
+        record.length = 0;
+        append(record, prefix);
+        int expand[] = { 0, (append(record, args), 0)... };
+        (void)expand;
+        ring.tail.store(tail + 1, std::memory_order_release);
+    }
+public:
+    // Message pieces are only formatted when the category is enabled in the mask.
+    template <class... Args>
+    static void logError(log_mask mask, const Args&... args) {
+        if (enabled(mask, log_category::ERROR))
+            log("[ERROR] ", args...);
+    }
+    template <class... Args>
+    static void logUnexpected(log_mask mask, const Args&... args) {
+        if (enabled(mask, log_category::UNEXPECTED))
+            log("[UNEXPECTED] ", args...);
+    }
+    template <class... Args>
+    static void logCrash(log_mask mask, const Args&... args) {
+        if (enabled(mask, log_category::CRASH))
+            log("[CRASH] ", args...);
+    }
+    template <class... Args>
+    static void logProcessInfo(log_mask mask, const Args&... args) {
+        if (enabled(mask, log_category::PROCESS_INFO))
+            log("[PROCESS INFO] ", args...);
+    }
+    // Waits until every record pushed so far has been written.
+    static void flush() {
+        backend& b = instance();
+        while (!b.idle())
+            std::this_thread::sleep_for(std::chrono::milliseconds(1));
+    }
+    static unsigned long long dropped() {
+        return instance().dropped.load();
+    }
+};
+
+// wyrand: one 64-bit add and one 64x64->128 multiply per number. Satisfies
+// UniformRandomBitGenerator, so it also works with <random> and <algorithm>.
+class wyrand {
+    uint64_t s;
+public:
+    using result_type = uint64_t;
+
+    explicit wyrand(uint64_t seed = 0) : s(seed) {};
+    static constexpr result_type min() {
+        return 0;
+    }
+    static constexpr result_type max() {
+        return ~0ull;
+    }
+    result_type operator()() {
+        s += 0xa0761d6478bd642full;
+        __uint128_t t = static_cast<__uint128_t>(s) * (s ^ 0xe7037ed1a0b428dbull);
+        return static_cast<uint64_t>(t >> 64) ^ static_cast<uint64_t>(t);
+    }
+    // Uniform in [0, n) by multiply-shift, without a division; n must not be 0.
+    uint64_t below(uint64_t n) {
+        return static_cast<uint64_t>((static_cast<__uint128_t>((*this)()) * n) >> 64);
+    }
+    uint64_t state() const {
+        return s;
+    }
+    void seed(uint64_t seed) {
+        s = seed;
+    }
+};
+
+// Spreads one campaign seed into independent per-worker seeds.
+static uint64_t splitmix64(uint64_t x) {
+    x += 0x9e3779b97f4a7c15ull;
+    x = (x ^ (x >> 30)) * 0xbf58476d1ce4e5b9ull;
+    x = (x ^ (x >> 27)) * 0x94d049bb133111ebull;
+    return x ^ (x >> 31);
+}
+
+static uint64_t randomSeed() {
+    std::random_device rd;
+    return static_cast<uint64_t>(rd()) << 32 | rd();
+}
+
+// Read-only bytes owned elsewhere: a vector or an entry in the mapped corpus.
+class byte_view {
+    const unsigned char* first;
+    size_t length;
+public:
+    byte_view() : first(nullptr), length(0) {};
+    byte_view(const unsigned char* d, size_t n) : first(d), length(n) {};
+    byte_view(const std::vector<unsigned char>& v) : first(v.data()), length(v.size()) {};
+    const unsigned char* data() const {
+        return first;
+    }
+    size_t size() const {
+        return length;
+    }
+    bool empty() const {
+        return length == 0;
+    }
+    const unsigned char* begin() const {
+        return first;
+    }
+    const unsigned char* end() const {
+        return first + length;
+    }
+    const unsigned char& operator[](size_t i) const {
+        return first[i];
+    }
+};
+
+// Content hash for deduplication, one multiply per 8 bytes.
+static uint64_t contentHash(byte_view bytes) {
+    uint64_t h = splitmix64(bytes.size());
+    size_t i = 0;
+    for (; i + 8 <= bytes.size(); i += 8) {
+        uint64_t w;
+        std::memcpy(&w, bytes.data() + i, 8);
+        h = (h ^ w) * 0x9e3779b97f4a7c15ull;
+        h ^= h >> 32;
+    }
+    uint64_t tail = 0;
+    if (i < bytes.size())
+        std::memcpy(&tail, bytes.data() + i, bytes.size() - i);
+    return splitmix64(h ^ tail);
+}
+
+// Bytes the target compares its input with. A token with a match replaces the match
+// wherever it occurs in an input (the other side of the comparison); one without goes to a
+// random offset.
+struct dictionary_token {
+    std::vector<unsigned char> value;
+    std::vector<unsigned char> match;
+};
+
+using token_list = std::vector<dictionary_token>;
+
+// Mutation operators. The in-place ones work on any byte span (a whole input or one JPEG
+// segment body); the others resize the buffer. havoc() stacks randomly chosen operators.
+class mutation_kernels {
+    static constexpr int ARITH_MAX = 35;
+
+    template <class T>
+    static T load(const unsigned char* p, bool bigEndian) {
+        T v;
+        std::memcpy(&v, p, sizeof(T));
+        return bigEndian ? byteSwap(v) : v;
+    }
+    template <class T>
+    static void store(unsigned char* p, T v, bool bigEndian) {
+        if (bigEndian)
+            v = byteSwap(v);
+        std::memcpy(p, &v, sizeof(T));
+    }
+    static uint8_t byteSwap(uint8_t v) {
+        return v;
+    }
+    static uint16_t byteSwap(uint16_t v) {
+        return __builtin_bswap16(v);
+    }
+    static uint32_t byteSwap(uint32_t v) {
+        return __builtin_bswap32(v);
+    }
+    template <class T>
+    static void arith(unsigned char* p, size_t n, wyrand& rng) {
+        if (n < sizeof(T))
+            return;
+        unsigned char* at = p + rng.below(n - sizeof(T) + 1);
+        bool bigEndian = rng.below(2);
+        T delta = static_cast<T>(1 + rng.below(ARITH_MAX));
+        T v = load<T>(at, bigEndian);
+        store<T>(at, static_cast<T>(rng.below(2) ? v + delta : v - delta), bigEndian);
+    }
+    template <class T>
+    static void interesting(unsigned char* p, size_t n, const T* values, size_t count, wyrand& rng) {
+        if (n < sizeof(T))
+            return;
+        store<T>(p + rng.below(n - sizeof(T) + 1), values[rng.below(count)], rng.below(2));
     }
 public:
-    static void logError(const std::string& message, std::regex regex) {
-        std::string logmessage = "[ERROR] " + message;
-        if(std::regex_search(logmessage, regex))
-            log(logmessage);
+    enum op {
+        FLIP_BIT,
+        FLIP_BYTES,
+        FLIP_RUN,
+        ARITH8,
+        ARITH16,
+        ARITH32,
+        INTERESTING8,
+        INTERESTING16,
+        INTERESTING32,
+        RANDOM_BYTE,
+        COPY_BLOCK,
+        IN_PLACE_OPS,
+        INSERT_BLOCK = IN_PLACE_OPS,
+        DELETE_BLOCK,
+        DUPLICATE_BLOCK,
+        SPLICE,
+        DICTIONARY,
+        ALL_OPS
+    };
+
+    static void flipBit(unsigned char* p, size_t n, wyrand& rng) {
+        size_t bit = rng.below(n * 8);
+        p[bit >> 3] ^= static_cast<unsigned char>(0x80 >> (bit & 7));
+    }
+    static void flipBytes(unsigned char* p, size_t n, wyrand& rng) {
+        size_t width = std::min<size_t>(n, size_t(1) << rng.below(3));
+        unsigned char* at = p + rng.below(n - width + 1);
+        for (size_t i = 0; i < width; ++i)
+            at[i] ^= 0xFF;
+    }
+    // Inverts a whole run; the loop is plain enough for the compiler to vectorize.
+    static void flipRun(unsigned char* p, size_t n, wyrand& rng) {
+        size_t len = 1 + rng.below(std::min<size_t>(n, 256));
+        unsigned char* __restrict at = p + rng.below(n - len + 1);
+        for (size_t i = 0; i < len; ++i)
+            at[i] ^= 0xFF;
+    }
+    static void randomByte(unsigned char* p, size_t n, wyrand& rng) {
+        p[rng.below(n)] ^= static_cast<unsigned char>(1 + rng.below(255));
+    }
+    static void copyBlock(unsigned char* p, size_t n, wyrand& rng) {
+        if (n < 2)
+            return;
+        size_t len = 1 + rng.below(std::min<size_t>(n - 1, 64));
+        size_t from = rng.below(n - len + 1);
+        size_t to = rng.below(n - len + 1);
+        std::memmove(p + to, p + from, len);
+    }
+    static void mutateInPlace(unsigned char* p, size_t n, wyrand& rng, op which) {
+        static const uint8_t interesting8[] = { 0x80, 0xFF, 0, 1, 16, 32, 64, 100, 127 };
+        static const uint16_t interesting16[] = { 0x8000, 0xFF7F, 128, 255, 256, 512, 1000, 1024, 4096, 32767, 0xFFFF, 0 };
+        static const uint32_t interesting32[] = { 0x80000000u, 0xFA0000FAu, 0xFFFF7FFFu, 32768, 65535, 65536, 0x05FFFF05u, 0x7FFFFFFFu, 0xFFFFFFFFu, 0 };
+        if (n == 0)
+            return;
+        switch (which) {
+        case FLIP_BIT: flipBit(p, n, rng); break;
+        case FLIP_BYTES: flipBytes(p, n, rng); break;
+        case FLIP_RUN: flipRun(p, n, rng); break;
+        case ARITH8: arith<uint8_t>(p, n, rng); break;
+        case ARITH16: arith<uint16_t>(p, n, rng); break;
+        case ARITH32: arith<uint32_t>(p, n, rng); break;
+        case INTERESTING8: interesting(p, n, interesting8, sizeof(interesting8), rng); break;
+        case INTERESTING16: interesting(p, n, interesting16, sizeof(interesting16) / 2, rng); break;
+        case INTERESTING32: interesting(p, n, interesting32, sizeof(interesting32) / 4, rng); break;
+        case RANDOM_BYTE: randomByte(p, n, rng); break;
+        default: copyBlock(p, n, rng); break;
+        }
+    }
+    static void mutateInPlace(unsigned char* p, size_t n, wyrand& rng) {
+        mutateInPlace(p, n, rng, static_cast<op>(rng.below(IN_PLACE_OPS)));
+    }
+
+    // The resizing operators work on [from, to) of the buffer and return the new end.
+    static size_t insertBlock(std::vector<unsigned char>& b, size_t from, size_t to, wyrand& rng) {
+        size_t len = 1 + rng.below(64);
+        size_t at = from + rng.below(to - from + 1);
+        if (rng.below(2)) {
+            b.insert(b.begin() + at, len, static_cast<unsigned char>(rng.below(256)));
+        }
+        else {
+            b.insert(b.begin() + at, len, 0);
+            for (size_t i = 0; i < len; ++i)
+                b[at + i] = static_cast<unsigned char>(rng());
+        }
+        return to + len;
+    }
+    static size_t deleteBlock(std::vector<unsigned char>& b, size_t from, size_t to, wyrand& rng) {
+        if (to - from < 2)
+            return to;
+        size_t len = 1 + rng.below(std::min<size_t>(to - from - 1, 64));
+        size_t at = from + rng.below(to - from - len + 1);
+        b.erase(b.begin() + at, b.begin() + at + len);
+        return to - len;
+    }
+    static size_t duplicateBlock(std::vector<unsigned char>& b, size_t from, size_t to, wyrand& rng) {
+        if (to == from)
+            return to;
+        size_t len = 1 + rng.below(std::min<size_t>(to - from, 64));
+        size_t src = from + rng.below(to - from - len + 1);
+        size_t at = from + rng.below(to - from + 1);
+        std::vector<unsigned char> block(b.begin() + src, b.begin() + src + len);
+        b.insert(b.begin() + at, block.begin(), block.end());
+        return to + len;
+    }
+    // Keeps a random prefix of the buffer and continues with the donor from the same offset.
+    static void splice(std::vector<unsigned char>& b, byte_view donor, wyrand& rng) {
+        size_t common = std::min(b.size(), donor.size());
+        if (common < 2)
+            return;
+        size_t point = 1 + rng.below(common - 1);
+        b.resize(point);
+        b.insert(b.end(), donor.begin() + point, donor.end());
+    }
+
+    // Overwrites an occurrence of token.match in [from, to) with token.value, looking from a
+    // random offset on. False if there is none.
+    static bool replaceMatch(std::vector<unsigned char>& b, size_t from, size_t to, const dictionary_token& token, wyrand& rng) {
+        size_t n = token.match.size();
+        if (n == 0 || n != token.value.size() || to - from < n)
+            return false;
+        size_t start = from + rng.below(to - from - n + 1);
+        auto find = [&](size_t lo, size_t hi) {
+            const void* at = hi - lo >= n ? memmem(b.data() + lo, hi - lo, token.match.data(), n) : nullptr;
+            return at ? static_cast<size_t>(static_cast<const unsigned char*>(at) - b.data()) : SIZE_MAX;
+        };
+        size_t at = find(start, to);
+        if (at == SIZE_MAX)
+            at = find(from, std::min(to, start + n - 1));
+        if (at == SIZE_MAX)
+            return false;
+        std::copy(token.value.begin(), token.value.end(), b.begin() + at);
+        return true;
+    }
+    // Puts a token into [from, to): over its match, else over random bytes or inserted.
+    static size_t putToken(std::vector<unsigned char>& b, size_t from, size_t to, const dictionary_token& token, wyrand& rng) {
+        if (replaceMatch(b, from, to, token, rng))
+            return to;
+        size_t n = token.value.size();
+        if (rng.below(2) && to - from >= n) {
+            std::copy(token.value.begin(), token.value.end(), b.begin() + from + rng.below(to - from - n + 1));
+            return to;
+        }
+        b.insert(b.begin() + from + rng.below(to - from + 1), token.value.begin(), token.value.end());
+        return to + n;
+    }
+
+    // Applies `stack` randomly chosen operators on top of each other.
+    static void havoc(std::vector<unsigned char>& b, size_t stack, wyrand& rng, byte_view donor = byte_view(), const token_list* tokens = nullptr) {
+        for (size_t k = 0; k < stack; ++k) {
+            if (b.empty()) {
+                insertBlock(b, 0, 0, rng);
+                continue;
+            }
+            op which = static_cast<op>(rng.below(ALL_OPS));
+            switch (which) {
+            case INSERT_BLOCK: insertBlock(b, 0, b.size(), rng); break;
+            case DELETE_BLOCK: deleteBlock(b, 0, b.size(), rng); break;
+            case DUPLICATE_BLOCK: duplicateBlock(b, 0, b.size(), rng); break;
+            case SPLICE:
+                if (!donor.empty())
+                    splice(b, donor, rng);
+                break;
+            case DICTIONARY:
+                if (tokens && !tokens->empty())
+                    putToken(b, 0, b.size(), (*tokens)[rng.below(tokens->size())], rng);
+                break;
+            default: mutateInPlace(b.data(), b.size(), rng, which); break;
+            }
+        }
+    }
+};
+
+enum class segment_kind {
+    MARKER,
+    ENTROPY_DATA,
+    TRAILING_DATA
+};
+
+struct jpeg_segment {
+    segment_kind kind;
+    unsigned char marker;
+    size_t offset;
+    size_t size;
+    size_t headerSize;
+
+    size_t bodyOffset() const {
+        return offset + headerSize;
     }
-    static void logUnexpected(const std::string& message, std::regex regex) {
-        std::string logmessage = "[UNEXPECTED] " + message;
-        if (std::regex_search(logmessage, regex))
-            log(logmessage);
+    size_t bodySize() const {
+        return size - headerSize;
     }
-    static void logCrash(const std::string& message, std::regex regex) {
-        std::string logmessage = "[CRASH] " + message;
-        if (std::regex_search(logmessage, regex))
-            log(logmessage);
+    bool hasLength() const {
+        return headerSize == 4;
+    }
+};
+
+// Marker framing of a JPEG: one entry per marker segment, per run of entropy-coded data
+// after SOS and for bytes after EOI or after the point where the framing breaks.
+class jpeg_index {
+public:
+    std::vector<jpeg_segment> segments;
+    bool valid = false;
+
+    static bool isStandalone(unsigned char marker) {
+        return marker == 0x01 || marker == 0xD8 || marker == 0xD9 || (marker >= 0xD0 && marker <= 0xD7);
     }
-    static void logProcessInfo(const std::string& message, std::regex regex) {
-        std::string logmessage = "[PROCESS INFO] " + message;
-        if (std::regex_search(logmessage, regex))
-            log(logmessage);
+
+    static jpeg_index parse(byte_view data) {
+        jpeg_index index;
+        size_t size = data.size();
+        if (size < 2 || data[0] != 0xFF || data[1] != 0xD8)
+            return index;
+        index.valid = true;
+        index.segments.push_back({ segment_kind::MARKER, 0xD8, 0, 2, 2 });
+        size_t pos = 2;
+        while (pos < size) {
+            if (pos + 1 >= size || data[pos] != 0xFF)
+                break;
+            unsigned char marker = data[pos + 1];
+            if (isStandalone(marker)) {
+                index.segments.push_back({ segment_kind::MARKER, marker, pos, 2, 2 });
+                pos += 2;
+                if (marker == 0xD9)
+                    break;
+                continue;
+            }
+            if (pos + 4 > size)
+                break;
+            size_t len = static_cast<size_t>(data[pos + 2]) << 8 | data[pos + 3];
+            if (len < 2 || pos + 2 + len > size)
+                break;
+            index.segments.push_back({ segment_kind::MARKER, marker, pos, 2 + len, 4 });
+            pos += 2 + len;
+            if (marker == 0xDA) {
+                // Entropy-coded data runs up to the next marker that is not a stuffed 0xFF00 or RSTn.
+                size_t start = pos;
+                while (pos + 1 < size && !(data[pos] == 0xFF && data[pos + 1] != 0 && (data[pos + 1] < 0xD0 || data[pos + 1] > 0xD7)))
+                    ++pos;
+                if (pos + 1 >= size)
+                    pos = size;
+                if (pos > start)
+                    index.segments.push_back({ segment_kind::ENTROPY_DATA, 0, start, pos - start, 0 });
+            }
+        }
+        if (pos < size)
+            index.segments.push_back({ segment_kind::TRAILING_DATA, 0, pos, size - pos, 0 });
+        return index;
     }
 };
 
+// The seed is read once; every mutation is built in a buffer the manager owns and reuses.
+// JPEG inputs are mutated inside their segments with the marker framing kept intact;
+// anything else gets random byte overwrites.
 class jpgManager {
     std::string inputFile;
-    std::string outputFile;
     int mutationCount;
+    bool loaded;
+    std::vector<unsigned char> seed;
+    jpeg_index seedIndex;
+    std::vector<unsigned char> buffer;
+    std::vector<jpeg_segment> segments;
+    wyrand rng;
+    std::shared_ptr<const token_list> tokens;
+
+    size_t below(size_t n) {
+        return rng.below(n);
+    }
+    static void putLength(unsigned char* p, size_t bodySize) {
+        p[0] = static_cast<unsigned char>((bodySize + 2) >> 8);
+        p[1] = static_cast<unsigned char>(bodySize + 2);
+    }
+    // Segments worth mutating; entropy-coded data is picked a quarter of the time.
+    int pickSegment() {
+        std::vector<int> headers, entropy;
+        for (size_t i = 0; i < segments.size(); ++i) {
+            if (segments[i].bodySize() == 0)
+                continue;
+            (segments[i].kind == segment_kind::MARKER ? headers : entropy).push_back(static_cast<int>(i));
+        }
+        if (!entropy.empty() && (headers.empty() || below(4) == 0))
+            return entropy[below(entropy.size())];
+        if (headers.empty())
+            return -1;
+        return headers[below(headers.size())];
+    }
+    // Replaces bytes [from, to) of the buffer and shifts every later segment.
+    void replaceBytes(int seg, size_t from, size_t to, const unsigned char* data, size_t n) {
+        buffer.erase(buffer.begin() + from, buffer.begin() + to);
+        buffer.insert(buffer.begin() + from, data, data + n);
+        ptrdiff_t delta = static_cast<ptrdiff_t>(n) - static_cast<ptrdiff_t>(to - from);
+        segments[seg].size += delta;
+        for (size_t i = seg + 1; i < segments.size(); ++i)
+            segments[i].offset += delta;
+        if (segments[seg].hasLength())
+            putLength(&buffer[segments[seg].offset + 2], segments[seg].bodySize());
+    }
+    void mutateBody(const jpeg_segment& s) {
+        size_t changes = 1 + below(4);
+        for (size_t k = 0; k < changes; ++k)
+            mutation_kernels::mutateInPlace(&buffer[s.bodyOffset()], s.bodySize(), rng);
+    }
+    void resizeBody(int seg) {
+        const jpeg_segment s = segments[seg];
+        size_t from = s.bodyOffset();
+        size_t to = from + s.bodySize();
+        size_t end;
+        switch (below(3)) {
+        case 0:
+            end = mutation_kernels::deleteBlock(buffer, from, to, rng);
+            break;
+        case 1:
+            end = mutation_kernels::duplicateBlock(buffer, from, to, rng);
+            break;
+        default:
+            end = mutation_kernels::insertBlock(buffer, from, to, rng);
+            break;
+        }
+        ptrdiff_t delta = static_cast<ptrdiff_t>(end) - static_cast<ptrdiff_t>(to);
+        segments[seg].size += delta;
+        for (size_t i = seg + 1; i < segments.size(); ++i)
+            segments[i].offset += delta;
+        if (s.hasLength() && segments[seg].bodySize() + 2 > 0xFFFF) {
+            // Too long for a length field: undo by trimming the body back.
+            buffer.erase(buffer.begin() + to, buffer.begin() + end);
+            segments[seg].size -= delta;
+            for (size_t i = seg + 1; i < segments.size(); ++i)
+                segments[i].offset -= delta;
+        }
+        if (s.hasLength())
+            putLength(&buffer[segments[seg].offset + 2], segments[seg].bodySize());
+    }
+    // Swaps in a donor segment with the same marker, or inserts a donor segment.
+    void spliceSegment(int seg, byte_view donor, const jpeg_index& donorIndex) {
+        std::vector<const jpeg_segment*> same, any;
+        for (const jpeg_segment& d : donorIndex.segments) {
+            if (d.kind != segment_kind::MARKER || d.marker == 0xD8 || d.marker == 0xD9)
+                continue;
+            any.push_back(&d);
+            if (d.marker == segments[seg].marker)
+                same.push_back(&d);
+        }
+        if (any.empty() || segments[seg].kind != segment_kind::MARKER)
+            return;
+        if (!same.empty()) {
+            const jpeg_segment& d = *same[below(same.size())];
+            replaceBytes(seg, segments[seg].offset, segments[seg].offset + segments[seg].size, &donor[d.offset], d.size);
+            return;
+        }
+        const jpeg_segment& d = *any[below(any.size())];
+        size_t at = segments[seg].offset;
+        buffer.insert(buffer.begin() + at, donor.begin() + d.offset, donor.begin() + d.offset + d.size);
+        jpeg_segment inserted = d;
+        inserted.offset = at;
+        for (size_t i = seg; i < segments.size(); ++i)
+            segments[i].offset += d.size;
+        segments.insert(segments.begin() + seg, inserted);
+    }
+
+    // Overwrites the bytes a token is compared with, wherever they are; without them the token
+    // goes into the segment body, over it or inserted with the length fixed up.
+    void putToken(int seg) {
+        const dictionary_token& token = (*tokens)[below(tokens->size())];
+        if (mutation_kernels::replaceMatch(buffer, 0, buffer.size(), token, rng))
+            return;
+        const jpeg_segment& s = segments[seg];
+        size_t n = token.value.size();
+        if (below(2) && s.bodySize() >= n) {
+            std::copy(token.value.begin(), token.value.end(), buffer.begin() + s.bodyOffset() + below(s.bodySize() - n + 1));
+            return;
+        }
+        if (s.hasLength() && s.bodySize() + n + 2 > 0xFFFF)
+            return;
+        size_t at = s.bodyOffset() + below(s.bodySize() + 1);
+        replaceBytes(seg, at, at, token.value.data(), n);
+    }
+
+    bool load(log_mask mask) {
+        std::ifstream inFile(inputFile, std::ios::binary);
+        if (!inFile) {
+            Logger::logError(mask, "Failed to open input file: ", inputFile);
+            return false;
+        }
+        seed.assign(std::istreambuf_iterator<char>(inFile), std::istreambuf_iterator<char>());
+        seedIndex = jpeg_index::parse(seed);
+        loaded = true;
+        return true;
+    }
 public:
-    jpgManager() {
-        inputFile = ' ';
-        outputFile = ' ';
-        mutationCount = 0;
-    };
-    jpgManager(const std::string& i, const std::string& o, const int& c) {
-        inputFile = i;
-        outputFile = o;
-        mutationCount = c;
-    };
+    jpgManager() : inputFile(" "), mutationCount(0), loaded(false), rng(randomSeed()) {};
+    jpgManager(const std::string& i, const int& c) : inputFile(i), mutationCount(c), loaded(false), rng(randomSeed()) {};
+    // Fixed seeds make a run reproducible.
+    void setSeed(uint64_t seed) {
+        rng.seed(seed);
+    }
+    // setSeed(rngState()) continues the same sequence, e.g. after a checkpoint.
+    uint64_t rngState() const {
+        return rng.state();
+    }
     void setIn(std::string in) {
         inputFile = in;
-    }
-    void setOut(const std::string& out) {
-        outputFile = out;
+        loaded = false;
     }
     void setMC(const int& n) {
         mutationCount = n;
     }
-    void mutate(std::regex regex) {
-        std::ifstream inFile(inputFile, std::ios::binary);
-        if (!inFile) {
-            Logger::logError("Failed to open input file: " + inputFile, regex);
-            return;
+    // Tokens for the dictionary operator; null or empty turns it off.
+    void setDictionary(std::shared_ptr<const token_list> t) {
+        tokens = std::move(t);
+    }
+    const std::vector<unsigned char>& seedData(log_mask mask) {
+        if (!loaded)
+            load(mask);
+        return seed;
+    }
+    const jpeg_index& seedSegments(log_mask mask) {
+        if (!loaded)
+            load(mask);
+        return seedIndex;
+    }
+    const std::vector<unsigned char>& mutate(log_mask mask) {
+        if (!loaded && !load(mask)) {
+            buffer.clear();
+            return buffer;
         }
-
+        return mutateFrom(seed, seedIndex);
+    }
+    // Stacks a few segment-level mutations on a copy of a parsed JPEG. Bodies are mutated
+    // in place or resized with their length field fixed up, and segments are spliced in
+    // from the donor when one is given.
+    const std::vector<unsigned char>& mutateFrom(byte_view source, const jpeg_index& index, byte_view donor = byte_view(), const jpeg_index* donorIndex = nullptr) {
+        if (!index.valid || index.segments.size() < 2)
+            return mutateFrom(source);
+        buffer.assign(source.begin(), source.end());
+        segments = index.segments;
+        bool canSplice = !donor.empty() && donorIndex && donorIndex->valid;
+        bool hasTokens = tokens && !tokens->empty();
+        size_t operations = 1 + below(4);
+        for (size_t k = 0; k < operations; ++k) {
+            int seg = pickSegment();
+            if (seg < 0)
+                break;
+            size_t op = below(hasTokens ? 12 : 10);
+            if (op < 6)
+                mutateBody(segments[seg]);
+            else if (op >= 10)
+                putToken(seg);
+            else if (op < 8 || !canSplice)
+                resizeBody(seg);
+            else
+                spliceSegment(seg, donor, *donorIndex);
+        }
+        return buffer;
+    }
+    // Child that takes every marker segment from either parent, matched by marker.
+    const std::vector<unsigned char>& crossover(byte_view first, const jpeg_index& firstIndex, byte_view second, const jpeg_index& secondIndex) {
+        buffer.clear();
+        if (!firstIndex.valid || !secondIndex.valid) {
+            buffer.assign(first.begin(), first.end());
+            return buffer;
+        }
+        for (const jpeg_segment& s : firstIndex.segments) {
+            const jpeg_segment* pick = &s;
+            const byte_view* from = &first;
+            if (s.kind == segment_kind::MARKER && below(2)) {
+                std::vector<const jpeg_segment*> matches;
+                for (const jpeg_segment& o : secondIndex.segments)
+                    if (o.kind == segment_kind::MARKER && o.marker == s.marker)
+                        matches.push_back(&o);
+                if (!matches.empty()) {
+                    pick = matches[below(matches.size())];
+                    from = &second;
+                }
+            }
+            buffer.insert(buffer.end(), from->begin() + pick->offset, from->begin() + pick->offset + pick->size);
+        }
+        return buffer;
+    }
+    // Havoc on a copy of another input: mutationCount stacked operators anywhere in it.
+    const std::vector<unsigned char>& mutateFrom(byte_view source, byte_view donor = byte_view()) {
+        buffer.assign(source.begin(), source.end());
+        mutation_kernels::havoc(buffer, mutationCount, rng, donor, tokens.get());
+        return buffer;
+    }
+    const std::vector<unsigned char>& data() const {
+        return buffer;
+    }
+    // Persists the last mutation, e.g. when it crashed the target.
+    bool save(const std::string& outputFile, log_mask mask) const {
         std::ofstream outFile(outputFile, std::ios::binary);
         if (!outFile) {
-            Logger::logError("Failed to open input file: " + outputFile, regex);
-            return;
+            Logger::logError(mask, "Failed to open output file: ", outputFile);
+            return false;
+        }
+        outFile.write(reinterpret_cast<const char*>(buffer.data()), buffer.size());
+        return true;
+    }
+};
+
+// Target input that never touches a disk: a memfd (or an unlinked tmpfs file) that is
+// rewritten in place. The target opens it through /proc/<pid>/fd/<fd>.
+class scratch_file {
+    int fd;
+    size_t size;
+    std::string filePath;
+public:
+    scratch_file(const std::string& tag) : fd(-1), size(0) {
+        std::string name = "fuzzer-" + std::to_string(getpid()) + "-" + tag;
+        fd = memfd_create(name.c_str(), MFD_CLOEXEC);
+        if (fd < 0) {
+            std::string shmPath = "/dev/shm/" + name;
+            fd = open(shmPath.c_str(), O_RDWR | O_CREAT | O_TRUNC | O_CLOEXEC, 0600);
+            if (fd >= 0)
+                unlink(shmPath.c_str());
+        }
+        if (fd >= 0)
+            filePath = "/proc/" + std::to_string(getpid()) + "/fd/" + std::to_string(fd);
+    }
+    scratch_file(const scratch_file&) = delete;
+    scratch_file& operator=(const scratch_file&) = delete;
+    ~scratch_file() {
+        if (fd >= 0)
+            close(fd);
+    }
+    bool valid() const {
+        return fd >= 0;
+    }
+    const std::string& path() const {
+        return filePath;
+    }
+    bool write(const unsigned char* data, size_t n) {
+        if (n != size) {
+            if (ftruncate(fd, n) < 0)
+                return false;
+            size = n;
+        }
+        size_t done = 0;
+        while (done < n) {
+            ssize_t w = pwrite(fd, data + done, n - done, done);
+            if (w <= 0)
+                return false;
+            done += w;
         }
+        return true;
+    }
+    bool write(const std::vector<unsigned char>& data) {
+        return write(data.data(), data.size());
+    }
+};
+
+extern char** environ;
+
+// Control and status descriptors shared with runtime/forkserver_rt.cpp.
+constexpr int FORKSRV_FD = 198;
+constexpr uint32_t FORKSRV_HELLO = 0x46535256;
+
+// What the fork server reports once a child is done.
+struct forksrv_status {
+    int32_t status;
+    uint32_t reserved;
+    uint64_t cpuMicros;
+    uint64_t peakRssKb;
+};
+
+// Control socket shared with runtime/harness_host.cpp.
+constexpr int HARNESS_FD = 198;
+constexpr uint32_t HARNESS_HELLO = 0x48524e53;
+
+// The host's answer to one run.
+struct harness_reply {
+    int32_t value;
+    uint32_t reserved;
+    uint64_t cpuMicros;
+    uint64_t peakRssKb;
+};
 
-        std::vector<unsigned char> buffer;
-        std::mt19937 rng(std::random_device{}());
-        std::uniform_int_distribution<std::size_t> byteDist(0, 255);
+// Coverage bitmap shared with runtime/coverage_rt.cpp; the target finds it on COV_FD.
+constexpr size_t MAP_SIZE = 1 << 16;
+constexpr int COV_FD = 197;
 
-        buffer.assign(std::istreambuf_iterator<char>(inFile), std::istreambuf_iterator<char>());
+// Hit counts are bucketed (1, 2, 3, 4-7, 8-15, 16-31, 32-127, 128+) so that loop
+// trip counts only matter when they change the order of magnitude.
+static const std::vector<uint16_t>& countClassLookup16() {
+    static const std::vector<uint16_t> table = [] {
+        uint8_t lookup8[256];
+        for (int i = 0; i < 256; ++i)
+            lookup8[i] = i == 0 ? 0 : i == 1 ? 1 : i == 2 ? 2 : i == 3 ? 4 : i < 8 ? 8 : i < 16 ? 16 : i < 32 ? 32 : i < 128 ? 64 : 128;
+        std::vector<uint16_t> t(65536);
+        for (int i = 0; i < 65536; ++i)
+            t[i] = static_cast<uint16_t>(lookup8[i >> 8] << 8 | lookup8[i & 0xff]);
+        return t;
+    }();
+    return table;
+}
+
+// Edge hit counts written by an instrumented target into a memfd mapping.
+class coverage_map {
+    int fd;
+    uint8_t* trace;
+public:
+    coverage_map() : fd(-1), trace(nullptr) {
+        fd = memfd_create("fuzzer-coverage", MFD_CLOEXEC);
+        if (fd < 0 || ftruncate(fd, MAP_SIZE) < 0)
+            return;
+        void* area = mmap(nullptr, MAP_SIZE, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+        if (area == MAP_FAILED)
+            return;
+        trace = static_cast<uint8_t*>(area);
+        // Touching the pages now puts them on the NUMA node of the creating thread.
+        reset();
+    }
+    coverage_map(const coverage_map&) = delete;
+    coverage_map& operator=(const coverage_map&) = delete;
+    ~coverage_map() {
+        if (trace)
+            munmap(trace, MAP_SIZE);
+        if (fd >= 0)
+            close(fd);
+    }
+    bool valid() const {
+        return trace != nullptr;
+    }
+    int descriptor() const {
+        return fd;
+    }
+    const uint8_t* data() const {
+        return trace;
+    }
+    void reset() {
+        std::memset(trace, 0, MAP_SIZE);
+    }
+    // Buckets the raw counts in place, a 64-bit word at a time; empty words are skipped.
+    // Returns a hash of the path from the words that were not, so it costs next to nothing.
+    uint64_t classify() {
+        const uint16_t* lookup = countClassLookup16().data();
+        uint64_t* words = reinterpret_cast<uint64_t*>(trace);
+        uint64_t h = 0;
+        for (size_t i = 0; i < MAP_SIZE / 8; ++i) {
+            uint64_t w = words[i];
+            if (!w)
+                continue;
+            uint16_t parts[4];
+            std::memcpy(parts, &w, sizeof(w));
+            for (uint16_t& part : parts)
+                part = lookup[part];
+            std::memcpy(&words[i], parts, sizeof(w));
+            h = (h ^ words[i] ^ static_cast<uint64_t>(i) << 48) * 0x9e3779b97f4a7c15ull;
+            h ^= h >> 32;
+        }
+        return splitmix64(h);
+    }
+    size_t edgesHit() const {
+        const uint64_t* words = reinterpret_cast<const uint64_t*>(trace);
+        size_t n = 0;
+        for (size_t i = 0; i < MAP_SIZE / 8; ++i) {
+            uint64_t w = words[i];
+            if (!w)
+                continue;
+            for (int b = 0; b < 8; ++b)
+                n += ((w >> (b * 8)) & 0xff) != 0;
+        }
+        return n;
+    }
+    bool empty() const {
+        const uint64_t* words = reinterpret_cast<const uint64_t*>(trace);
+        uint64_t any = 0;
+        for (size_t i = 0; i < MAP_SIZE / 8; ++i)
+            any |= words[i];
+        return any == 0;
+    }
+    // Hash of the classified map; inputs that take the same paths get the same hash.
+    uint64_t pathHash() {
+        classify();
+        return contentHash(byte_view(trace, MAP_SIZE));
+    }
+};
 
-        for (std::size_t i = 0; i < mutationCount; ++i) {
-            std::uniform_int_distribution<std::size_t> posDist(0, buffer.size() - 1);
-            std::size_t mutationPos = posDist(rng);
+// Bits of every bucket not seen yet by the campaign.
+class virgin_map {
+    std::vector<uint64_t> bits;
+public:
+    enum novelty {
+        NOTHING = 0,
+        NEW_COUNTS = 1,
+        NEW_EDGES = 2
+    };
 
-            unsigned char mutationByte = static_cast<unsigned char>(byteDist(rng));
-            buffer[mutationPos] = mutationByte;
+    virgin_map() : bits(MAP_SIZE / 8, ~0ull) {};
+    // Compares a classified trace against the map and clears the bits it covers.
+    novelty update(const coverage_map& map) {
+        return update(map.data());
+    }
+    // The same for a copy of a classified trace, MAP_SIZE bytes.
+    novelty update(const uint8_t* classified) {
+        const uint64_t* trace = reinterpret_cast<const uint64_t*>(classified);
+        novelty result = NOTHING;
+        for (size_t i = 0; i < bits.size(); ++i) {
+            uint64_t cur = trace[i];
+            if (!cur || !(cur & bits[i]))
+                continue;
+            if (result != NEW_EDGES) {
+                // A byte that is still all ones marks an edge that was never hit.
+                uint64_t v = bits[i];
+                for (int b = 0; b < 8; ++b) {
+                    if (((cur >> (b * 8)) & 0xff) && ((v >> (b * 8)) & 0xff) == 0xff) {
+                        result = NEW_EDGES;
+                        break;
+                    }
+                }
+                if (result == NOTHING)
+                    result = NEW_COUNTS;
+            }
+            bits[i] &= ~cur;
         }
+        return result;
+    }
+    byte_view raw() const {
+        return byte_view(reinterpret_cast<const unsigned char*>(bits.data()), bits.size() * sizeof(uint64_t));
+    }
+    bool restore(byte_view saved) {
+        if (saved.size() != bits.size() * sizeof(uint64_t))
+            return false;
+        std::memcpy(bits.data(), saved.data(), saved.size());
+        return true;
+    }
+    size_t edgesSeen() const {
+        size_t n = 0;
+        for (uint64_t v : bits)
+            for (int b = 0; b < 8; ++b)
+                if (((v >> (b * 8)) & 0xff) != 0xff)
+                    ++n;
+        return n;
+    }
+};
 
-        outFile.write(reinterpret_cast<const char*>(buffer.data()), buffer.size());
+// Environment of the target: the fuzzer's own plus overrides. It is built before fork,
+// because the child of a multithreaded process must not allocate.
+class target_env {
+    std::vector<std::string> entries;
+    std::vector<char*> pointers;
+public:
+    target_env() {
+        for (char** e = environ; *e; ++e)
+            entries.push_back(*e);
+    }
+    void set(const std::string& name, const std::string& value) {
+        std::string prefix = name + "=";
+        entries.erase(std::remove_if(entries.begin(), entries.end(), [&](const std::string& e) {
+            return e.compare(0, prefix.size(), prefix) == 0;
+            }), entries.end());
+        entries.push_back(prefix + value);
+    }
+    char** data() {
+        pointers.clear();
+        for (std::string& e : entries)
+            pointers.push_back(&e[0]);
+        pointers.push_back(nullptr);
+        return pointers.data();
     }
 };
 
-class algorithm {
-protected:
-    virtual void execute(std::regex regex) = 0;
+enum class exec_status {
+    OK,
+    CRASH,
+    UNEXPECTED,
+    TIMEOUT,
+    ERROR
+};
+
+struct exec_result {
+    exec_status status = exec_status::ERROR;
+    int exitCode = 0;
+    int signal = 0;
+    // Filled from the crash report when the runtime's handler saw the crash. For a timeout
+    // stackHash is the hash of the coverage reached before the target was killed.
+    uint64_t pc = 0;
+    uint64_t faultAddress = 0;
+    uint64_t stackHash = 0;
+    // What the run cost the target: user plus system CPU time and peak resident memory.
+    // 0 when the executor could not tell. Wall time is measured by the callers.
+    uint64_t cpuMicros = 0;
+    uint64_t peakRssKb = 0;
+    // Filled from a sanitizer report on stderr: which sanitizer, the kind of bug, the size of
+    // the bad access if it says, and the first frame of the stack.
+    std::string sanitizer;
+    std::string bugType;
+    uint32_t accessSize = 0;
+    bool writeAccess = false;
+    std::string topFrame;
+    // Hash of what the target output, when the executor captures its output.
+    uint64_t outputHash = 0;
+    std::string error;
+};
+
+// Page the runtime's crash handler writes to; the target finds it on CRASH_FD.
+constexpr int CRASH_FD = 196;
+
+struct crash_report {
+    uint32_t valid;
+    int32_t signal;
+    uint64_t pc;
+    uint64_t address;
+    uint64_t stackHash;
+};
+
+class crash_report_page {
+    int fd;
+    crash_report* report;
+public:
+    crash_report_page() : fd(-1), report(nullptr) {
+        fd = memfd_create("fuzzer-crash", MFD_CLOEXEC);
+        if (fd < 0 || ftruncate(fd, sizeof(crash_report)) < 0)
+            return;
+        void* page = mmap(nullptr, sizeof(crash_report), PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+        if (page != MAP_FAILED)
+            report = static_cast<crash_report*>(page);
+    }
+    crash_report_page(const crash_report_page&) = delete;
+    crash_report_page& operator=(const crash_report_page&) = delete;
+    ~crash_report_page() {
+        if (report)
+            munmap(report, sizeof(crash_report));
+        if (fd >= 0)
+            close(fd);
+    }
+    bool valid() const {
+        return report != nullptr;
+    }
+    int descriptor() const {
+        return fd;
+    }
+    void reset() {
+        if (report)
+            report->valid = 0;
+    }
+    void collect(exec_result& result) const {
+        if (!report || !report->valid || report->signal != result.signal)
+            return;
+        result.pc = report->pc;
+        result.faultAddress = report->address;
+        result.stackHash = report->stackHash;
+    }
+};
+
+// Table the runtime's trace-cmp hooks log failed comparisons to; the target finds it on
+// CMP_FD. Each entry has the operand size and the operands, the constant first if one is.
+constexpr int CMP_FD = 195;
+constexpr uint32_t CMP_ENTRIES = 4096;
+constexpr uint32_t CMP_CONST = 1;
+
+struct cmp_entry {
+    uint32_t size;
+    uint32_t flags;
+    uint64_t first;
+    uint64_t second;
+};
+
+struct cmp_table {
+    uint32_t count;
+    uint32_t generation;
+    cmp_entry entries[CMP_ENTRIES];
+};
+
+class cmp_log {
+    int fd;
+    cmp_table* table;
+public:
+    cmp_log() : fd(-1), table(nullptr) {
+        fd = memfd_create("fuzzer-cmp", MFD_CLOEXEC);
+        if (fd < 0 || ftruncate(fd, sizeof(cmp_table)) < 0)
+            return;
+        void* shared = mmap(nullptr, sizeof(cmp_table), PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+        if (shared != MAP_FAILED)
+            table = static_cast<cmp_table*>(shared);
+    }
+    cmp_log(const cmp_log&) = delete;
+    cmp_log& operator=(const cmp_log&) = delete;
+    ~cmp_log() {
+        if (table)
+            munmap(table, sizeof(cmp_table));
+        if (fd >= 0)
+            close(fd);
+    }
+    bool valid() const {
+        return table != nullptr;
+    }
+    int descriptor() const {
+        return fd;
+    }
+    // A new generation also clears the runtime's per-run deduplication.
+    void reset() {
+        if (!table)
+            return;
+        table->count = 0;
+        table->generation++;
+    }
+    size_t size() const {
+        return table ? std::min(table->count, CMP_ENTRIES) : 0;
+    }
+    const cmp_entry& operator[](size_t i) const {
+        return table->entries[i];
+    }
+};
+
+// Picks the first sanitizer report out of a target's stderr as it arrives, line by line:
+// the "ERROR: AddressSanitizer: <bug>" style headers of ASan, MSan, TSan and LSan, UBSan's
+// "runtime error: <bug>" lines, ASan's "READ|WRITE of size N" and the frames of the stack
+// that follows. Frames are named by function when the report is symbolized and by module
+// offset otherwise, so their hash survives ASLR; sanitizer runtime frames are skipped.
+// Lines longer than LINE_LIMIT are cut, and nothing after the first stack is looked at.
+class sanitizer_parser {
+public:
+    static constexpr size_t LINE_LIMIT = 512;
+    static constexpr int STACK_DEPTH = 8;
+private:
+    enum stage { HEADER, FRAMES, DONE };
+    stage state;
+    std::string line;
+    std::string sanitizer;
+    std::string bugType;
+    std::string location;
+    std::string topFrame;
+    uint64_t topOffset;
+    uint32_t accessSize;
+    bool writeAccess;
+    int frames;
+    uint64_t frameHash;
+
+    static bool startsWith(const std::string& text, size_t at, const char* prefix) {
+        return text.compare(at, std::strlen(prefix), prefix) == 0;
+    }
+    // A stable name for a kind of bug: the first words of the description, up to a colon,
+    // a number, a quote or a preposition. "signed integer overflow: 1 + 2" becomes
+    // "signed-integer-overflow", "heap-buffer-overflow on address" "heap-buffer-overflow".
+    static std::string bugName(const std::string& text, size_t at) {
+        std::string name;
+        for (int words = 0; words < 4 && at < text.size(); ++words) {
+            size_t end = text.find(' ', at);
+            std::string word = text.substr(at, end == std::string::npos ? std::string::npos : end - at);
+            bool last = !word.empty() && word.back() == ':';
+            if (last)
+                word.pop_back();
+            if (word.empty() || word == "on" || word == "at" || word == "in" || word == "for" || word.find_first_of("0123456789'\"(") != std::string::npos)
+                break;
+            name += (name.empty() ? "" : "-") + word;
+            if (last || end == std::string::npos)
+                break;
+            at = end + 1;
+        }
+        return name;
+    }
+    void parseHeader() {
+        size_t at = line.find("ERROR: ");
+        size_t skip = 7;
+        if (at == std::string::npos) {
+            at = line.find("WARNING: ");
+            skip = 9;
+        }
+        size_t end = at == std::string::npos ? at : line.find("Sanitizer: ", at + skip);
+        if (end != std::string::npos) {
+            sanitizer = line.substr(at + skip, end + 9 - at - skip);
+            bugType = bugName(line, end + 11);
+            state = FRAMES;
+            return;
+        }
+        at = line.find(": runtime error: ");
+        if (at != std::string::npos) {
+            sanitizer = "UndefinedBehaviorSanitizer";
+            bugType = bugName(line, at + 17);
+            location = line.substr(0, at);
+            state = FRAMES;
+        }
+    }
+    // "    #0 0x4c6c1a in parse_sof /src/jpeg.cpp:42:5" or "    #1 0x7f75  (/lib/libc.so.6+0x27249)".
+    bool parseFrame() {
+        size_t at = line.find_first_not_of(' ');
+        if (at == std::string::npos || line[at] != '#' || at + 1 >= line.size() || line[at + 1] < '0' || line[at + 1] > '9')
+            return false;
+        at = line.find(' ', at);
+        at = at == std::string::npos ? at : line.find(' ', line.find_first_not_of(' ', at));
+        at = at == std::string::npos ? at : line.find_first_not_of(' ', at);
+        if (at == std::string::npos)
+            return true;
+        std::string name;
+        uint64_t offset = 0;
+        if (startsWith(line, at, "in ")) {
+            size_t last = line.rfind(' ');
+            name = line.substr(at + 3, last > at + 3 ? last - at - 3 : std::string::npos);
+            for (const char* runtime : { "__interceptor_", "__asan_", "__msan_", "__tsan_", "__ubsan_", "__sanitizer_" })
+                if (startsWith(name, 0, runtime))
+                    return true;
+        }
+        else if (line[at] == '(') {
+            size_t plus = line.rfind('+');
+            size_t slash = line.rfind('/', plus);
+            if (plus == std::string::npos || plus < at)
+                return true;
+            name = line.substr(slash == std::string::npos || slash < at ? at + 1 : slash + 1);
+            if (!name.empty() && name.back() == ')')
+                name.pop_back();
+            offset = std::strtoull(line.c_str() + plus + 1, nullptr, 16);
+        }
+        if (name.empty())
+            return true;
+        if (frames == 0) {
+            topFrame = name;
+            topOffset = offset;
+        }
+        frameHash = splitmix64(frameHash ^ contentHash(byte_view(reinterpret_cast<const unsigned char*>(name.data()), name.size())));
+        if (++frames == STACK_DEPTH)
+            state = DONE;
+        return true;
+    }
+    void parseLine() {
+        if (state == HEADER) {
+            parseHeader();
+        }
+        else if (state == FRAMES) {
+            size_t at = line.find_first_not_of(' ');
+            if (at != std::string::npos && (startsWith(line, at, "READ of size ") || startsWith(line, at, "WRITE of size "))) {
+                writeAccess = line[at] == 'W';
+                accessSize = static_cast<uint32_t>(std::strtoul(line.c_str() + line.find("size ") + 5, nullptr, 10));
+            }
+            else if (!parseFrame() && frames > 0) {
+                state = DONE;
+            }
+        }
+        line.clear();
+    }
+public:
+    sanitizer_parser() {
+        line.reserve(LINE_LIMIT);
+        reset();
+    }
+    void reset() {
+        state = HEADER;
+        line.clear();
+        sanitizer.clear();
+        bugType.clear();
+        location.clear();
+        topFrame.clear();
+        topOffset = 0;
+        accessSize = 0;
+        writeAccess = false;
+        frames = 0;
+        frameHash = 0;
+    }
+    void feed(const char* data, size_t size) {
+        while (size > 0 && state != DONE) {
+            const char* newline = static_cast<const char*>(std::memchr(data, '\n', size));
+            size_t length = newline ? static_cast<size_t>(newline - data) : size;
+            line.append(data, std::min(length, LINE_LIMIT - std::min(line.size(), LINE_LIMIT)));
+            if (!newline)
+                return;
+            parseLine();
+            data = newline + 1;
+            size -= length + 1;
+        }
+    }
+    // Fills in the report if there was one, which makes the run a crash. The bug type and
+    // the frames (or, without a stack, the source location) make up its stack hash.
+    bool collect(exec_result& result) {
+        if (state != DONE && !line.empty())
+            parseLine();
+        if (sanitizer.empty())
+            return false;
+        uint64_t where = frames ? frameHash : contentHash(byte_view(reinterpret_cast<const unsigned char*>(location.data()), location.size()));
+        result.status = exec_status::CRASH;
+        result.sanitizer = sanitizer;
+        result.bugType = bugType;
+        result.accessSize = accessSize;
+        result.writeAccess = writeAccess;
+        result.topFrame = topFrame.empty() ? location : topFrame;
+        result.pc = topOffset;
+        result.stackHash = splitmix64(where ^ contentHash(byte_view(reinterpret_cast<const unsigned char*>(bugType.data()), bugType.size())));
+        return true;
+    }
+};
+
+// The target's stderr: a pipe that is drained into a sanitizer_parser while the target
+// runs, through a read buffer reused for every run. Both ends are non-blocking, so a target
+// that writes faster than the fuzzer reads loses output rather than stalling on a full pipe.
+class stderr_capture {
+    int readFd;
+    int writeFd;
+    std::vector<char> buffer;
+    sanitizer_parser parser;
+public:
+    static constexpr size_t BUFFER_SIZE = 16384;
+
+    stderr_capture() : readFd(-1), writeFd(-1), buffer(BUFFER_SIZE) {
+        int fds[2];
+        if (pipe2(fds, O_CLOEXEC | O_NONBLOCK) < 0)
+            return;
+        readFd = fds[0];
+        writeFd = fds[1];
+    }
+    stderr_capture(const stderr_capture&) = delete;
+    stderr_capture& operator=(const stderr_capture&) = delete;
+    ~stderr_capture() {
+        if (readFd >= 0)
+            close(readFd);
+        if (writeFd >= 0)
+            close(writeFd);
+    }
+    bool valid() const {
+        return readFd >= 0;
+    }
+    // The end the target writes to.
+    int descriptor() const {
+        return writeFd;
+    }
+    // The end to poll for output.
+    int reader() const {
+        return readFd;
+    }
+    // Reads and parses whatever is in the pipe, without waiting for more.
+    void drain() {
+        ssize_t n;
+        while ((n = read(readFd, buffer.data(), buffer.size())) > 0)
+            parser.feed(buffer.data(), static_cast<size_t>(n));
+    }
+    void reset() {
+        parser.reset();
+    }
+    bool collect(exec_result& result) {
+        return parser.collect(result);
+    }
+};
+
+// What a target outputs, for comparing targets with each other: its stdout, kept in a memfd,
+// or a file it writes to. Emptied before and hashed after every run, through a read buffer
+// reused for every run.
+class output_capture {
+    int fd;
+    std::string file;
+    std::vector<unsigned char> buffer;
+
+    static constexpr size_t READ_SIZE = 65536;
+public:
+    output_capture() : fd(-1) {};
+    output_capture(const output_capture&) = delete;
+    output_capture& operator=(const output_capture&) = delete;
+    ~output_capture() {
+        if (fd >= 0)
+            close(fd);
+    }
+    bool captureStdout() {
+        if (fd < 0)
+            fd = memfd_create("fuzzer-stdout", MFD_CLOEXEC);
+        return fd >= 0;
+    }
+    void captureFile(const std::string& path) {
+        file = path;
+    }
+    bool enabled() const {
+        return fd >= 0 || !file.empty();
+    }
+    // The memfd for the target's stdout, or -1 when stdout is not captured.
+    int descriptor() const {
+        return fd;
+    }
+    // The target shares the memfd's offset, so rewinding it here rewinds the target's stdout.
+    // An output file is removed, so a run that writes none does not pass for the last one.
+    void reset() {
+        if (fd >= 0) {
+            if (ftruncate(fd, 0) == 0)
+                lseek(fd, 0, SEEK_SET);
+        }
+        else if (!file.empty()) {
+            unlink(file.c_str());
+        }
+    }
+    uint64_t hash() {
+        buffer.clear();
+        int in = fd >= 0 ? fd : open(file.c_str(), O_RDONLY | O_CLOEXEC);
+        for (ssize_t n = 1; in >= 0 && n > 0;) {
+            size_t done = buffer.size();
+            buffer.resize(done + READ_SIZE);
+            n = pread(in, buffer.data() + done, READ_SIZE, static_cast<off_t>(done));
+            buffer.resize(done + (n > 0 ? static_cast<size_t>(n) : 0));
+        }
+        if (in >= 0 && in != fd)
+            close(in);
+        return contentHash(byte_view(buffer.data(), buffer.size()));
+    }
+};
+
+// Signals that count as a crash of the target (the POSIX side of STATUS_ACCESS_VIOLATION).
+static bool isCrashSignal(int sig) {
+    return sig == SIGSEGV || sig == SIGBUS || sig == SIGILL || sig == SIGFPE || sig == SIGABRT || sig == SIGTRAP;
+}
+
+static exec_result decodeWaitStatus(int status) {
+    exec_result result;
+    if (WIFEXITED(status)) {
+        result.status = exec_status::OK;
+        result.exitCode = WEXITSTATUS(status);
+    }
+    else if (WIFSIGNALED(status)) {
+        result.signal = WTERMSIG(status);
+        result.status = isCrashSignal(result.signal) ? exec_status::CRASH : exec_status::UNEXPECTED;
+    }
+    else {
+        result.status = exec_status::UNEXPECTED;
+    }
+    return result;
+}
+
+static uint64_t cpuMicros(const rusage& usage) {
+    return (usage.ru_utime.tv_sec + usage.ru_stime.tv_sec) * 1000000ull + usage.ru_utime.tv_usec + usage.ru_stime.tv_usec;
+}
+
+static const char* signalName(int sig) {
+    const char* name = strsignal(sig);
+    return name ? name : "unknown";
+}
+
+// Runs the target on a fixed input file. Callers rewrite the file between runs.
+// With a coverage map the map is cleared before every run and handed to the target on COV_FD.
+class executor {
+protected:
+    std::string programPath;
+    std::string inputFile;
+    coverage_map* coverage;
+    crash_report_page crashReport;
+    cmp_log* comparisons;
+    stderr_capture errorOutput;
+    output_capture outputCapture;
+    target_env env;
+    unsigned timeoutMs;
+    unsigned memoryLimitMb;
+    int timerFd;
+
+    // Clears per-run state shared with the target.
+    void prepareRun() {
+        if (coverage)
+            coverage->reset();
+        if (comparisons)
+            comparisons->reset();
+        crashReport.reset();
+        errorOutput.reset();
+        if (outputCapture.enabled())
+            outputCapture.reset();
+    }
+    // Reads what the target wrote during a run it finished on its own.
+    void collectOutputs(exec_result& result) {
+        // ASan and MSan exit with a plain exit code after their report.
+        errorOutput.collect(result);
+        if (outputCapture.enabled())
+            result.outputHash = outputCapture.hash();
+    }
+    // Caps the address space of a target process that is about to exec, or has just been spawned.
+    void applyMemoryLimit(pid_t pid = 0) const {
+        if (!memoryLimitMb)
+            return;
+        rlimit limit;
+        limit.rlim_cur = limit.rlim_max = static_cast<rlim_t>(memoryLimitMb) << 20;
+        prlimit(pid, RLIMIT_AS, &limit, nullptr);
+    }
+    exec_result finishRun(int status, bool timedOut = false) {
+        exec_result result = decodeWaitStatus(status);
+        if (timedOut) {
+            result.status = exec_status::TIMEOUT;
+            result.stackHash = coverage ? coverage->pathHash() : 0;
+        }
+        else {
+            if (result.status == exec_status::CRASH)
+                crashReport.collect(result);
+            collectOutputs(result);
+        }
+        return result;
+    }
+    // Blocks until fd is readable or the timeout passes, whichever comes first, and drains
+    // the target's stderr meanwhile. The deadline is a one-shot timerfd polled together with
+    // fd and the stderr pipe. Returns false on timeout. The target writes its stderr before
+    // fd becomes readable, so the last poll also sees the end of it.
+    bool awaitReadable(int fd) {
+        bool deadline = timeoutMs && timerFd >= 0;
+        if (!deadline && !errorOutput.valid())
+            return true;
+        if (deadline) {
+            itimerspec expiry{};
+            expiry.it_value.tv_sec = timeoutMs / 1000;
+            expiry.it_value.tv_nsec = static_cast<long>(timeoutMs % 1000) * 1000000;
+            timerfd_settime(timerFd, 0, &expiry, nullptr);
+        }
+        pollfd fds[3] = { { fd, POLLIN, 0 }, { deadline ? timerFd : -1, POLLIN, 0 }, { errorOutput.reader(), POLLIN, 0 } };
+        for (;;) {
+            if (poll(fds, 3, -1) < 0) {
+                if (errno == EINTR)
+                    continue;
+                break;
+            }
+            if (fds[2].revents)
+                errorOutput.drain();
+            if (fds[0].revents || fds[1].revents)
+                break;
+        }
+        if (deadline) {
+            itimerspec disarm{};
+            timerfd_settime(timerFd, 0, &disarm, nullptr);
+            uint64_t expirations;
+            if (fds[1].revents && read(timerFd, &expirations, sizeof(expirations)) < 0)
+                expirations = 0;
+        }
+        return fds[0].revents != 0;
+    }
+public:
+    executor(const std::string& p, const std::string& i, coverage_map* c) : programPath(p), inputFile(i), coverage(c), comparisons(nullptr), timeoutMs(0), memoryLimitMb(0) {
+        timerFd = timerfd_create(CLOCK_MONOTONIC, TFD_CLOEXEC | TFD_NONBLOCK);
+        if (coverage)
+            env.set("FUZZER_COV", "1");
+        if (crashReport.valid())
+            env.set("FUZZER_CRASH", "1");
+        // Sanitizer reports are read from stderr. Leak checks at every exit would be slow and
+        // report the same leaks over and over; UBSan stops at its first report, with a stack.
+        // ASan must not insist on coming first, as the fork-server runtime is preloaded.
+        if (!std::getenv("ASAN_OPTIONS"))
+            env.set("ASAN_OPTIONS", "detect_leaks=0:verify_asan_link_order=0");
+        if (!std::getenv("UBSAN_OPTIONS"))
+            env.set("UBSAN_OPTIONS", "print_stacktrace=1:halt_on_error=1");
+    };
+    virtual ~executor() {
+        if (timerFd >= 0)
+            close(timerFd);
+    };
+    virtual exec_result run() = 0;
+    virtual std::string name() const = 0;
+    const std::string& inputPath() const {
+        return inputFile;
+    }
+    // Has the target log its comparisons to `log`. Must come before the target is started.
+    void traceComparisons(cmp_log* log) {
+        comparisons = log;
+        env.set("FUZZER_CMP", "1");
+    }
+    // Captures the target's output for outputHash: its stdout, or with a file name the file
+    // the target writes to, which it finds in FUZZER_OUTPUT. Must come before the target is
+    // started.
+    bool captureOutput(const std::string& file = "") {
+        if (file.empty())
+            return outputCapture.captureStdout();
+        outputCapture.captureFile(file);
+        env.set("FUZZER_OUTPUT", file);
+        return true;
+    }
+    // Caps the address space of the target at `mb` megabytes, so an input that needs more
+    // fails its allocation and most likely aborts. 0 is no limit. Must come before the target
+    // is started.
+    void limitMemory(unsigned mb) {
+        memoryLimitMb = mb;
+    }
+    // 0 waits for the target forever.
+    void setTimeout(unsigned ms) {
+        timeoutMs = ms;
+    }
+    unsigned timeout() const {
+        return timeoutMs;
+    }
+};
+
+// Starts a fresh process for every input.
+class spawn_executor : public executor {
+public:
+    spawn_executor(const std::string& p, const std::string& i, coverage_map* c) : executor(p, i, c) {};
+    exec_result run() override {
+        posix_spawn_file_actions_t actions;
+        posix_spawn_file_actions_init(&actions);
+        if (outputCapture.descriptor() >= 0)
+            posix_spawn_file_actions_adddup2(&actions, outputCapture.descriptor(), STDOUT_FILENO);
+        else
+            posix_spawn_file_actions_addopen(&actions, STDOUT_FILENO, "/dev/null", O_WRONLY, 0);
+        if (errorOutput.valid())
+            posix_spawn_file_actions_adddup2(&actions, errorOutput.descriptor(), STDERR_FILENO);
+        else
+            posix_spawn_file_actions_addopen(&actions, STDERR_FILENO, "/dev/null", O_WRONLY, 0);
+        prepareRun();
+        if (coverage)
+            posix_spawn_file_actions_adddup2(&actions, coverage->descriptor(), COV_FD);
+        if (crashReport.valid())
+            posix_spawn_file_actions_adddup2(&actions, crashReport.descriptor(), CRASH_FD);
+        if (comparisons)
+            posix_spawn_file_actions_adddup2(&actions, comparisons->descriptor(), CMP_FD);
+
+        char* argv[] = { const_cast<char*>(programPath.c_str()), const_cast<char*>(inputFile.c_str()), nullptr };
+        pid_t pid;
+        int err = posix_spawn(&pid, programPath.c_str(), &actions, nullptr, argv, env.data());
+        posix_spawn_file_actions_destroy(&actions);
+
+        exec_result result;
+        if (err != 0) {
+            result.error = std::strerror(err);
+            return result;
+        }
+        // posix_spawn cannot set a limit in the child, so the target may run for a moment
+        // before it applies.
+        applyMemoryLimit(pid);
+        // A pidfd becomes readable when the child exits; without one there is no deadline,
+        // and stderr is only drained once the child is gone.
+        bool timedOut = false;
+        int pidFd = -1;
+#ifdef SYS_pidfd_open
+        if (timeoutMs || errorOutput.valid())
+            pidFd = static_cast<int>(syscall(SYS_pidfd_open, pid, 0));
+#endif
+        if (pidFd >= 0) {
+            if (!awaitReadable(pidFd)) {
+                kill(pid, SIGKILL);
+                timedOut = true;
+            }
+            close(pidFd);
+        }
+        int status;
+        rusage usage{};
+        if (wait4(pid, &status, 0, &usage) < 0) {
+            result.status = exec_status::UNEXPECTED;
+            return result;
+        }
+        if (errorOutput.valid())
+            errorOutput.drain();
+        result = finishRun(status, timedOut);
+        result.cpuMicros = cpuMicros(usage);
+        // The child was vforked, and Linux counts the peak of the image exec replaced (the
+        // fuzzer's) in it; only a peak above the fuzzer's own is the target's.
+        rusage self{};
+        getrusage(RUSAGE_SELF, &self);
+        if (usage.ru_maxrss > self.ru_maxrss)
+            result.peakRssKb = static_cast<uint64_t>(usage.ru_maxrss);
+        return result;
+    }
+    std::string name() const override {
+        return "spawn";
+    }
+};
+
+// Starts the target once with the fork-server runtime preloaded. The runtime stops
+// right before main and forks a fresh child for every request on the control pipe.
+class forkserver_executor : public executor {
+    std::string runtimePath;
+    pid_t serverPid;
+    int ctlFd;
+    int stFd;
+
+    bool readFull(void* data, size_t size) {
+        return read(stFd, data, size) == static_cast<ssize_t>(size);
+    }
+public:
+    forkserver_executor(const std::string& p, const std::string& i, const std::string& r, coverage_map* c) : executor(p, i, c), runtimePath(r), serverPid(-1), ctlFd(-1), stFd(-1) {
+        env.set("LD_PRELOAD", runtimePath);
+        env.set("FUZZER_FORKSRV", "1");
+    };
+    ~forkserver_executor() override {
+        stop();
+    }
+    bool start() {
+        // Other workers start their servers at the same time; O_CLOEXEC keeps these pipe ends
+        // out of them, so a dead server's status pipe reaches EOF. dup2 clears it in the child.
+        int ctl[2], st[2];
+        if (pipe2(ctl, O_CLOEXEC) < 0)
+            return false;
+        if (pipe2(st, O_CLOEXEC) < 0) {
+            close(ctl[0]);
+            close(ctl[1]);
+            return false;
+        }
+        char* argv[] = { const_cast<char*>(programPath.c_str()), const_cast<char*>(inputFile.c_str()), nullptr };
+        char** envp = env.data();
+        serverPid = fork();
+        if (serverPid == 0) {
+            dup2(ctl[0], FORKSRV_FD);
+            dup2(st[1], FORKSRV_FD + 1);
+            close(ctl[0]); close(ctl[1]); close(st[0]); close(st[1]);
+            if (coverage)
+                dup2(coverage->descriptor(), COV_FD);
+            if (crashReport.valid())
+                dup2(crashReport.descriptor(), CRASH_FD);
+            if (comparisons)
+                dup2(comparisons->descriptor(), CMP_FD);
+            int devnull = open("/dev/null", O_WRONLY);
+            dup2(outputCapture.descriptor() >= 0 ? outputCapture.descriptor() : devnull, STDOUT_FILENO);
+            dup2(errorOutput.valid() ? errorOutput.descriptor() : devnull, STDERR_FILENO);
+            close(devnull);
+            applyMemoryLimit();
+            execve(programPath.c_str(), argv, envp);
+            _exit(127);
+        }
+        close(ctl[0]);
+        close(st[1]);
+        ctlFd = ctl[1];
+        stFd = st[0];
+        if (serverPid < 0) {
+            stop();
+            return false;
+        }
+
+        // A target that ignores the runtime just runs main and closes the pipe.
+        pollfd pfd{ stFd, POLLIN, 0 };
+        uint32_t hello = 0;
+        if (poll(&pfd, 1, 10000) != 1 || !readFull(&hello, sizeof(hello)) || hello != FORKSRV_HELLO) {
+            stop();
+            return false;
+        }
+        return true;
+    }
+    void stop() {
+        if (ctlFd >= 0)
+            close(ctlFd);
+        if (stFd >= 0)
+            close(stFd);
+        ctlFd = stFd = -1;
+        if (serverPid > 0) {
+            kill(serverPid, SIGKILL);
+            waitpid(serverPid, nullptr, 0);
+        }
+        serverPid = -1;
+    }
+    exec_result run() override {
+        exec_result result;
+        if (serverPid < 0 && !start()) {
+            result.error = "fork server is not running";
+            return result;
+        }
+        prepareRun();
+        uint32_t go = 0;
+        int32_t childPid;
+        forksrv_status status;
+        if (write(ctlFd, &go, sizeof(go)) != sizeof(go) || !readFull(&childPid, sizeof(childPid)) || childPid <= 0) {
+            stop();
+            result.error = "fork server did not start a child";
+            return result;
+        }
+        // The server reports the status of a killed child like any other.
+        bool timedOut = !awaitReadable(stFd);
+        if (timedOut)
+            kill(childPid, SIGKILL);
+        if (!readFull(&status, sizeof(status))) {
+            stop();
+            result.status = exec_status::UNEXPECTED;
+            return result;
+        }
+        result = finishRun(status.status, timedOut);
+        result.cpuMicros = status.cpuMicros;
+        result.peakRssKb = status.peakRssKb;
+        return result;
+    }
+    std::string name() const override {
+        return "forkserver";
+    }
+};
+
+// Runs a target library in a runtime/harness_host.cpp process that calls its
+//   extern "C" int fuzz_one(const uint8_t* data, size_t size);
+// once per input, with no fork or exec per run. The host is a sacrificial child: a run that
+// crashes or hangs takes it down and the next run starts a fresh one. It is also restarted
+// every RESTART_RUNS runs, and as soon as its resident memory grew by LEAK_LIMIT_MB, so leaks
+// and state left behind by earlier inputs do not pile up. The fork-server runtime is
+// preloaded into the host only for its crash reports.
+class inprocess_executor : public executor {
+    std::string hostPath;
+    log_mask mask;
+    pid_t hostPid;
+    int socketFd;
+    unsigned long long runs;
+    long baselinePages;
+
+    static constexpr unsigned long long RESTART_RUNS = 100000;
+    static constexpr unsigned long long MEMORY_CHECK_RUNS = 1000;
+    static constexpr long LEAK_LIMIT_MB = 64;
+
+    long residentPages() const {
+        std::ifstream statm("/proc/" + std::to_string(hostPid) + "/statm");
+        long size = 0, resident = 0;
+        statm >> size >> resident;
+        return resident;
+    }
+    // Restarts the host when it is due, or when it seems to leak.
+    void checkHost() {
+        if (runs == 1)
+            baselinePages = residentPages();
+        if (runs >= RESTART_RUNS) {
+            stop();
+        }
+        else if (runs % MEMORY_CHECK_RUNS == 0) {
+            long grownMb = (residentPages() - baselinePages) * sysconf(_SC_PAGESIZE) >> 20;
+            if (grownMb >= LEAK_LIMIT_MB) {
+                Logger::logUnexpected(mask, "Harness host grew by ", grownMb, " MB in ", runs, " runs, restarting it: ", programPath);
+                stop();
+            }
+        }
+    }
+public:
+    // p is the target library, h the host executable and r the fork-server runtime (may be empty).
+    inprocess_executor(const std::string& p, const std::string& i, const std::string& h, const std::string& r, coverage_map* c, log_mask m) : executor(p, i, c), hostPath(h), mask(m), hostPid(-1), socketFd(-1), runs(0), baselinePages(0) {
+        if (!r.empty())
+            env.set("LD_PRELOAD", r);
+    };
+    ~inprocess_executor() override {
+        stop();
+    }
+    bool start() {
+        int pair[2];
+        if (socketpair(AF_UNIX, SOCK_STREAM | SOCK_CLOEXEC, 0, pair) < 0)
+            return false;
+        char* argv[] = { const_cast<char*>(hostPath.c_str()), const_cast<char*>(programPath.c_str()), const_cast<char*>(inputFile.c_str()), nullptr };
+        char** envp = env.data();
+        hostPid = fork();
+        if (hostPid == 0) {
+            dup2(pair[1], HARNESS_FD);
+            if (coverage)
+                dup2(coverage->descriptor(), COV_FD);
+            if (crashReport.valid())
+                dup2(crashReport.descriptor(), CRASH_FD);
+            if (comparisons)
+                dup2(comparisons->descriptor(), CMP_FD);
+            int devnull = open("/dev/null", O_WRONLY);
+            dup2(outputCapture.descriptor() >= 0 ? outputCapture.descriptor() : devnull, STDOUT_FILENO);
+            dup2(errorOutput.valid() ? errorOutput.descriptor() : devnull, STDERR_FILENO);
+            close(devnull);
+            applyMemoryLimit();
+            execve(hostPath.c_str(), argv, envp);
+            _exit(127);
+        }
+        close(pair[1]);
+        socketFd = pair[0];
+        runs = 0;
+        if (hostPid < 0) {
+            stop();
+            return false;
+        }
+        // The host says hello once the library is loaded and exports fuzz_one.
+        pollfd pfd{ socketFd, POLLIN, 0 };
+        uint32_t hello = 0;
+        if (poll(&pfd, 1, 10000) != 1 || recv(socketFd, &hello, sizeof(hello), MSG_WAITALL) != sizeof(hello) || hello != HARNESS_HELLO) {
+            stop();
+            return false;
+        }
+        return true;
+    }
+    void stop() {
+        if (socketFd >= 0)
+            close(socketFd);
+        socketFd = -1;
+        if (hostPid > 0) {
+            kill(hostPid, SIGKILL);
+            waitpid(hostPid, nullptr, 0);
+        }
+        hostPid = -1;
+    }
+    exec_result run() override {
+        exec_result result;
+        if (hostPid < 0 && !start()) {
+            result.error = "harness host did not start; does " + programPath + " load and export fuzz_one?";
+            return result;
+        }
+        prepareRun();
+        uint32_t go = 0;
+        if (send(socketFd, &go, sizeof(go), MSG_NOSIGNAL) != sizeof(go)) {
+            stop();
+            result.error = "harness host is gone";
+            return result;
+        }
+        bool timedOut = !awaitReadable(socketFd);
+        if (timedOut)
+            kill(hostPid, SIGKILL);
+        harness_reply reply;
+        if (timedOut || recv(socketFd, &reply, sizeof(reply), MSG_WAITALL) != sizeof(reply)) {
+            // The input took the host down; its wait status is the result of the run.
+            int status = 0;
+            close(socketFd);
+            socketFd = -1;
+            if (waitpid(hostPid, &status, 0) < 0)
+                status = 0;
+            hostPid = -1;
+            return finishRun(status, timedOut);
+        }
+        result.status = exec_status::OK;
+        result.exitCode = reply.value;
+        result.cpuMicros = reply.cpuMicros;
+        result.peakRssKb = reply.peakRssKb;
+        // UBSan without halt_on_error reports and lets fuzz_one return.
+        collectOutputs(result);
+        ++runs;
+        checkHost();
+        return result;
+    }
+    std::string name() const override {
+        return "inprocess";
+    }
+};
+
+// Helper files are looked up next to the fuzzer unless the environment variable names one.
+static std::string helperPath(const char* variable, const char* fileName) {
+    if (const char* env = std::getenv(variable))
+        return env;
+    char self[4096];
+    ssize_t len = readlink("/proc/self/exe", self, sizeof(self) - 1);
+    if (len <= 0)
+        return fileName;
+    self[len] = '\0';
+    return (fs::path(self).parent_path() / fileName).string();
+}
+
+static std::string forkserverRuntimePath() {
+    return helperPath("FUZZER_FORKSRV_RT", "forkserver_rt.so");
+}
+
+static std::string harnessHostPath() {
+    return helperPath("FUZZER_HARNESS_HOST", "harness_host");
+}
+
+// A target library (*.so) runs in-process, anything else under the fork server if its
+// runtime is there, or spawned per input. memoryLimitMb caps the target's address space.
+// With captureOutput the runs hash the target's stdout, or outputFile if one is named.
+static std::unique_ptr<executor> makeExecutor(const std::string& programPath, const std::string& inputFile, log_mask mask, coverage_map* coverage = nullptr, cmp_log* comparisons = nullptr, unsigned memoryLimitMb = 0, bool captureOutput = false, const std::string& outputFile = "") {
+    std::string runtime = forkserverRuntimePath();
+    if (fs::path(programPath).extension() == ".so") {
+        std::unique_ptr<inprocess_executor> harness(new inprocess_executor(programPath, inputFile, harnessHostPath(), fs::exists(runtime) ? runtime : "", coverage, mask));
+        if (comparisons)
+            harness->traceComparisons(comparisons);
+        harness->limitMemory(memoryLimitMb);
+        if (captureOutput)
+            harness->captureOutput(outputFile);
+        if (!harness->start())
+            Logger::logError(mask, "Harness host ", harnessHostPath(), " could not load ", programPath);
+        return harness;
+    }
+    if (fs::exists(runtime)) {
+        std::unique_ptr<forkserver_executor> server(new forkserver_executor(programPath, inputFile, runtime, coverage));
+        if (comparisons)
+            server->traceComparisons(comparisons);
+        server->limitMemory(memoryLimitMb);
+        if (captureOutput)
+            server->captureOutput(outputFile);
+        if (server->start())
+            return server;
+        Logger::logUnexpected(mask, "Fork server handshake failed, spawning a process per input: ", programPath);
+    }
+    std::unique_ptr<executor> spawned(new spawn_executor(programPath, inputFile, coverage));
+    if (comparisons)
+        spawned->traceComparisons(comparisons);
+    spawned->limitMemory(memoryLimitMb);
+    if (captureOutput)
+        spawned->captureOutput(outputFile);
+    return spawned;
+}
+
+static std::string toHex(uint64_t value) {
+    char digits[17];
+    auto end = std::to_chars(digits, digits + sizeof(digits), value, 16).ptr;
+    return std::string(digits, end);
+}
+
+// Directory the campaign keeps its state in: the one holding the sample file or directory.
+static fs::path workDirectory(std::string sample) {
+    while (sample.size() > 1 && sample.back() == '/')
+        sample.pop_back();
+    return fs::path(sample).parent_path();
+}
+
+static std::string crashDirectory(const std::string& sample) {
+    return (workDirectory(sample) / "crashes").string();
+}
+
+static std::string hangDirectory(const std::string& sample) {
+    return (workDirectory(sample) / "hangs").string();
+}
+
+static std::string corpusDirectory(const std::string& sample) {
+    return (workDirectory(sample) / "corpus").string();
+}
+
+static std::string perfDirectory(const std::string& sample) {
+    return (workDirectory(sample) / "perf").string();
+}
+
+static std::string diffDirectory(const std::string& sample) {
+    return (workDirectory(sample) / "diffs").string();
+}
+
+// Crashes bucketed by signal, faulting pc and stack hash. The exec loop looks buckets up
+// in memory; <dir>/index.txt keeps them across campaigns, with one input per bucket.
+class crash_index {
+public:
+    struct bucket {
+        uint64_t key;
+        int signal;
+        uint64_t pc;
+        uint64_t stackHash;
+        uint64_t hits;
+        std::string file;
+    };
+    struct outcome {
+        uint64_t key;
+        uint64_t hits;
+        bool isNew;
+        std::string file;
+    };
+private:
+    std::string directory;
+    std::unordered_map<uint64_t, bucket> buckets;
+    uint64_t totalHits;
+    mutable std::mutex mutex;
+
+    bool saveLocked() const {
+        std::string indexPath = (fs::path(directory) / "index.txt").string();
+        std::string tmpPath = indexPath + ".tmp";
+        {
+            std::ofstream out(tmpPath);
+            if (!out)
+                return false;
+            for (const auto& entry : buckets) {
+                const bucket& b = entry.second;
+                out << toHex(b.key) << ' ' << b.signal << ' ' << toHex(b.pc) << ' ' << toHex(b.stackHash) << ' ' << b.hits << ' ' << b.file << '\n';
+            }
+        }
+        return std::rename(tmpPath.c_str(), indexPath.c_str()) == 0;
+    }
+public:
+    crash_index(const std::string& dir) : directory(dir), totalHits(0) {};
+    static uint64_t keyOf(const exec_result& result) {
+        uint64_t key = splitmix64(static_cast<uint64_t>(result.signal));
+        key = splitmix64(key ^ result.pc);
+        return splitmix64(key ^ result.stackHash);
+    }
+    bool load() {
+        std::error_code ec;
+        fs::create_directories(directory, ec);
+        std::ifstream in((fs::path(directory) / "index.txt").string());
+        std::string key, pc, stackHash;
+        bucket b;
+        std::lock_guard<std::mutex> lock(mutex);
+        while (in >> key >> b.signal >> pc >> stackHash >> b.hits >> b.file) {
+            b.key = std::stoull(key, nullptr, 16);
+            b.pc = std::stoull(pc, nullptr, 16);
+            b.stackHash = std::stoull(stackHash, nullptr, 16);
+            buckets[b.key] = b;
+        }
+        return !ec;
+    }
+    bool save() const {
+        std::lock_guard<std::mutex> lock(mutex);
+        return saveLocked();
+    }
+    // Counts a crash; the first crash of a bucket also stores its input and the index.
+    outcome record(const exec_result& result, const std::vector<unsigned char>& input) {
+        return record(keyOf(result), input, result.signal, result.pc, result.stackHash);
+    }
+    // Counts a finding under a key of the caller's. Findings that are not crashes, such as
+    // targets that disagree, have no signal, pc or stack.
+    outcome record(uint64_t key, const std::vector<unsigned char>& input, int signal = 0, uint64_t pc = 0, uint64_t stackHash = 0) {
+        std::lock_guard<std::mutex> lock(mutex);
+        ++totalHits;
+        auto found = buckets.find(key);
+        if (found != buckets.end()) {
+            ++found->second.hits;
+            return { key, found->second.hits, false, found->second.file };
+        }
+        bucket& b = buckets[key];
+        b = { key, signal, pc, stackHash, 1, toHex(key) + ".jpg" };
+        std::ofstream out((fs::path(directory) / b.file).string(), std::ios::binary);
+        out.write(reinterpret_cast<const char*>(input.data()), input.size());
+        out.close();
+        saveLocked();
+        return { key, 1, true, b.file };
+    }
+    size_t size() const {
+        std::lock_guard<std::mutex> lock(mutex);
+        return buckets.size();
+    }
+    uint64_t hits() const {
+        std::lock_guard<std::mutex> lock(mutex);
+        return totalHits;
+    }
+};
+
+// Costly inputs a campaign can hunt for besides new coverage: ones that make the target
+// spend much CPU time, or reach a high peak of resident memory.
+enum class perf_objective {
+    NONE,
+    TIME,
+    MEMORY
+};
+
+static const char* objectiveName(perf_objective o) {
+    switch (o) {
+    case perf_objective::TIME: return "TIME";
+    case perf_objective::MEMORY: return "MEMORY";
+    default: return "NONE";
+    }
+}
+
+static bool parseObjective(const std::string& name, perf_objective& o) {
+    for (perf_objective candidate : { perf_objective::NONE, perf_objective::TIME, perf_objective::MEMORY }) {
+        if (name == objectiveName(candidate)) {
+            o = candidate;
+            return true;
+        }
+    }
+    return false;
+}
+
+// The TOP_K inputs with the most CPU time and the TOP_K with the highest peak memory seen,
+// in <dir>/time and <dir>/memory, each with an index.txt of "value file" lines that keeps
+// them across campaigns. A ranking is a min-heap, so a run that does not make it costs one
+// comparison with the lowest value kept; an input that drops out of it is deleted.
+// Used by one thread only.
+class perf_store {
+public:
+    static constexpr size_t TOP_K = 16;
+private:
+    struct ranked {
+        uint64_t value;
+        std::string file;
+    };
+    struct ranking {
+        std::string directory;
+        std::vector<ranked> heap;
+        uint64_t best = 0;
+    };
+    ranking rankings[2];
+
+    static bool lower(const ranked& a, const ranked& b) {
+        return a.value > b.value;
+    }
+    ranking& of(perf_objective o) {
+        return rankings[o == perf_objective::MEMORY];
+    }
+    static bool save(const ranking& r) {
+        std::string indexPath = (fs::path(r.directory) / "index.txt").string();
+        std::string tmpPath = indexPath + ".tmp";
+        {
+            std::ofstream out(tmpPath);
+            if (!out)
+                return false;
+            for (const ranked& entry : r.heap)
+                out << entry.value << ' ' << entry.file << '\n';
+        }
+        return std::rename(tmpPath.c_str(), indexPath.c_str()) == 0;
+    }
+public:
+    perf_store(const std::string& dir) {
+        rankings[0].directory = (fs::path(dir) / "time").string();
+        rankings[1].directory = (fs::path(dir) / "memory").string();
+    };
+    bool load() {
+        std::error_code ec;
+        for (ranking& r : rankings) {
+            fs::create_directories(r.directory, ec);
+            if (ec)
+                return false;
+            std::ifstream in((fs::path(r.directory) / "index.txt").string());
+            ranked entry;
+            while (r.heap.size() < TOP_K && in >> entry.value >> entry.file) {
+                if (fs::exists(fs::path(r.directory) / entry.file)) {
+                    r.heap.push_back(entry);
+                    r.best = std::max(r.best, entry.value);
+                }
+            }
+            std::make_heap(r.heap.begin(), r.heap.end(), lower);
+        }
+        return true;
+    }
+    // Ranks an input by what one run of it cost; true if it made the top K. An input
+    // already in the ranking stays in with its first value.
+    bool record(perf_objective o, uint64_t value, const std::vector<unsigned char>& input) {
+        ranking& r = of(o);
+        if (!value || (r.heap.size() >= TOP_K && value <= r.heap.front().value))
+            return false;
+        std::string file = toHex(contentHash(input)) + ".jpg";
+        for (const ranked& entry : r.heap)
+            if (entry.file == file)
+                return false;
+        if (r.heap.size() >= TOP_K) {
+            std::pop_heap(r.heap.begin(), r.heap.end(), lower);
+            std::error_code ec;
+            fs::remove(fs::path(r.directory) / r.heap.back().file, ec);
+            r.heap.pop_back();
+        }
+        std::ofstream out((fs::path(r.directory) / file).string(), std::ios::binary);
+        out.write(reinterpret_cast<const char*>(input.data()), input.size());
+        out.close();
+        r.heap.push_back({ value, file });
+        std::push_heap(r.heap.begin(), r.heap.end(), lower);
+        r.best = std::max(r.best, value);
+        save(r);
+        return true;
+    }
+    // The highest value ranked: CPU microseconds for TIME, kilobytes for MEMORY.
+    uint64_t best(perf_objective o) const {
+        return rankings[o == perf_objective::MEMORY].best;
+    }
+};
+
+// Hands out one core per worker, claimed with an flock on fuzzer-cpu<N>.lock in
+// $FUZZER_LOCK_DIR (else /tmp) so that no other fuzzer instance on the host pins to it.
+class cpu_placement {
+public:
+    struct core {
+        int cpu = -1;
+        // -1 if the kernel knows no NUMA nodes.
+        int node = -1;
+        int lockFd = -1;
+    };
+private:
+    mutable std::mutex mutex;
+    bool enabled = false;
+    cpu_set_t allowed;
+    std::vector<core> claimed;
+    // What was held after the latest claim, so the placement still shows once it ends.
+    std::vector<core> latest;
+
+    static std::string lockPath(int cpu) {
+        const char* dir = std::getenv("FUZZER_LOCK_DIR");
+        return std::string(dir && *dir ? dir : "/tmp") + "/fuzzer-cpu" + std::to_string(cpu) + ".lock";
+    }
+    // The sysfs directory of a cpu holds a nodeN link to its NUMA node.
+    static int nodeOf(int cpu) {
+        std::error_code error;
+        fs::directory_iterator it(fs::path("/sys/devices/system/cpu/cpu" + std::to_string(cpu)), error), end;
+        for (; !error && it != end; it.increment(error)) {
+            std::string name = it->path().filename().string();
+            if (name.size() > 4 && name.compare(0, 4, "node") == 0 && name[4] >= '0' && name[4] <= '9')
+                return std::atoi(name.c_str() + 4);
+        }
+        return -1;
+    }
+public:
+    static cpu_placement& global() {
+        static cpu_placement placement;
+        return placement;
+    }
+    // Starts a new campaign on the calling thread; its mask bounds the cores handed out.
+    void reset(bool enable) {
+        std::lock_guard<std::mutex> lock(mutex);
+        enabled = enable && sched_getaffinity(0, sizeof(allowed), &allowed) == 0;
+        latest.clear();
+    }
+    // Claims up to count free cores, every free one for 0 or less.
+    std::vector<core> claim(int count) {
+        std::vector<core> cores;
+        std::lock_guard<std::mutex> lock(mutex);
+        if (!enabled)
+            return cores;
+        for (int cpu = 0; cpu < CPU_SETSIZE && (count <= 0 || static_cast<int>(cores.size()) < count); ++cpu) {
+            if (!CPU_ISSET(cpu, &allowed))
+                continue;
+            // Creating a file another user owns in a sticky directory may be refused.
+            std::string path = lockPath(cpu);
+            core c;
+            c.cpu = cpu;
+            c.lockFd = open(path.c_str(), O_RDONLY | O_CLOEXEC);
+            if (c.lockFd < 0)
+                c.lockFd = open(path.c_str(), O_RDONLY | O_CREAT | O_CLOEXEC, 0644);
+            if (c.lockFd < 0)
+                continue;
+            if (flock(c.lockFd, LOCK_EX | LOCK_NB) < 0) {
+                close(c.lockFd);
+                continue;
+            }
+            c.node = nodeOf(cpu);
+            cores.push_back(c);
+            claimed.push_back(c);
+        }
+        if (!cores.empty())
+            latest = claimed;
+        return cores;
+    }
+    void release(const core& c) {
+        std::lock_guard<std::mutex> lock(mutex);
+        auto it = std::find_if(claimed.begin(), claimed.end(), [&](const core& held) { return held.cpu == c.cpu; });
+        if (it != claimed.end())
+            claimed.erase(it);
+        close(c.lockFd);
+    }
+    // Pins the calling thread to the core; processes it starts from then on inherit it.
+    static bool pin(const core& c) {
+        cpu_set_t set;
+        CPU_ZERO(&set);
+        CPU_SET(c.cpu, &set);
+        return sched_setaffinity(0, sizeof(set), &set) == 0;
+    }
+    // The cores held right now, in cpu order, or the last ones held if none are.
+    std::vector<core> cores() const {
+        std::lock_guard<std::mutex> lock(mutex);
+        std::vector<core> held = claimed.empty() ? latest : claimed;
+        std::sort(held.begin(), held.end(), [](const core& a, const core& b) { return a.cpu < b.cpu; });
+        return held;
+    }
+};
+
+// Keeps the calling thread on a core of its own while it lives and gives it back its mask after.
+class pinned_thread {
+    cpu_placement::core claimed;
+    cpu_set_t previous;
+public:
+    pinned_thread() {
+        std::vector<cpu_placement::core> cores = cpu_placement::global().claim(1);
+        if (cores.empty())
+            return;
+        if (sched_getaffinity(0, sizeof(previous), &previous) < 0 || !cpu_placement::pin(cores[0])) {
+            cpu_placement::global().release(cores[0]);
+            return;
+        }
+        claimed = cores[0];
+    }
+    pinned_thread(const pinned_thread&) = delete;
+    pinned_thread& operator=(const pinned_thread&) = delete;
+    ~pinned_thread() {
+        if (claimed.cpu < 0)
+            return;
+        sched_setaffinity(0, sizeof(previous), &previous);
+        cpu_placement::global().release(claimed);
+    }
+};
+
+// Long-lived workers. A job of `count` iterations is cut into chunks that are dealt out
+// to per-worker deques; a worker whose deque runs dry steals from the back of another's.
+class worker_pool {
+    struct chunk {
+        int begin;
+        int end;
+    };
+    struct alignas(64) chunk_queue {
+        std::mutex mutex;
+        std::deque<chunk> chunks;
+    };
+
+    std::vector<std::thread> threads;
+    std::vector<std::unique_ptr<chunk_queue>> queues;
+    std::vector<cpu_placement::core> cores;
+    std::function<void(int, int)> job;
+    std::mutex mutex;
+    std::condition_variable wake;
+    std::condition_variable done;
+    unsigned generation;
+    int busy;
+    bool stopping;
+    bool everyWorker;
+
+    bool take(int id, chunk& c) {
+        int n = static_cast<int>(queues.size());
+        for (int k = 0; k < n; ++k) {
+            chunk_queue& q = *queues[(id + k) % n];
+            std::lock_guard<std::mutex> lock(q.mutex);
+            if (q.chunks.empty())
+                continue;
+            if (k == 0) {
+                c = q.chunks.front();
+                q.chunks.pop_front();
+            }
+            else {
+                c = q.chunks.back();
+                q.chunks.pop_back();
+            }
+            return true;
+        }
+        return false;
+    }
+    void workerLoop(int id) {
+        if (id < static_cast<int>(cores.size()))
+            cpu_placement::pin(cores[id]);
+        unsigned seen = 0;
+        for (;;) {
+            bool once;
+            {
+                std::unique_lock<std::mutex> lock(mutex);
+                wake.wait(lock, [&] { return stopping || generation != seen; });
+                if (stopping)
+                    return;
+                seen = generation;
+                once = everyWorker;
+            }
+            chunk c;
+            if (once)
+                job(id, id);
+            while (!once && take(id, c)) {
+                for (int i = c.begin; i < c.end; ++i)
+                    job(id, i);
+            }
+            std::lock_guard<std::mutex> lock(mutex);
+            if (--busy == 0)
+                done.notify_all();
+        }
+    }
+public:
+    // Worker k runs on the k-th core claimed from cpu_placement, if there is one. 0 workers
+    // means one per free core, or one per hardware thread if none was claimed.
+    worker_pool(int n = 0) : generation(0), busy(0), stopping(false), everyWorker(false) {
+        cores = cpu_placement::global().claim(n);
+        if (n <= 0)
+            n = cores.empty() ? std::max(1u, std::thread::hardware_concurrency()) : static_cast<int>(cores.size());
+        for (int i = 0; i < n; ++i)
+            queues.emplace_back(new chunk_queue);
+        for (int i = 0; i < n; ++i)
+            threads.emplace_back(&worker_pool::workerLoop, this, i);
+    }
+    worker_pool(const worker_pool&) = delete;
+    worker_pool& operator=(const worker_pool&) = delete;
+    ~worker_pool() {
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+            stopping = true;
+        }
+        wake.notify_all();
+        for (std::thread& thread : threads)
+            thread.join();
+        for (const cpu_placement::core& c : cores)
+            cpu_placement::global().release(c);
+    }
+    int size() const {
+        return static_cast<int>(threads.size());
+    }
+    // Calls fn(worker) once on the thread of every worker and blocks until all are done; for
+    // setup that belongs to the worker's core, like memory it touches first and processes
+    // it starts.
+    void each(std::function<void(int)> fn) {
+        std::unique_lock<std::mutex> lock(mutex);
+        job = [&fn](int worker, int) { fn(worker); };
+        everyWorker = true;
+        busy = size();
+        ++generation;
+        wake.notify_all();
+        done.wait(lock, [&] { return busy == 0; });
+        everyWorker = false;
+        job = nullptr;
+    }
+    // Calls fn(worker, index) for every index in [0, count) and blocks until all are done.
+    void run(int count, int chunkSize, std::function<void(int, int)> fn) {
+        if (count <= 0)
+            return;
+        chunkSize = std::max(1, chunkSize);
+        int n = size();
+        int next = 0;
+        for (int begin = 0; begin < count; begin += chunkSize) {
+            chunk_queue& q = *queues[next++ % n];
+            std::lock_guard<std::mutex> lock(q.mutex);
+            q.chunks.push_back({ begin, std::min(count, begin + chunkSize) });
+        }
+        std::unique_lock<std::mutex> lock(mutex);
+        job = std::move(fn);
+        busy = n;
+        ++generation;
+        wake.notify_all();
+        done.wait(lock, [&] { return busy == 0; });
+        job = nullptr;
+    }
+};
+
+// Inputs stored once per content hash. Their bytes are appended to <dir>/corpus.pack,
+// which is mapped into a reserved address range so views stay valid while it grows; the
+// fixed-size entries of <dir>/corpus.idx are read in one go at startup.
+class corpus_store {
+public:
+    static constexpr uint32_t NO_PARENT = UINT32_MAX;
+
+    struct entry {
+        uint64_t hash;
+        uint64_t offset;
+        uint64_t coverageHash;
+        uint32_t size;
+        uint32_t parent;
+        uint32_t execMicros;
+        uint32_t reserved;
+    };
+private:
+    static constexpr uint64_t INDEX_MAGIC = 0x3130504f4352465aull;
+    static constexpr size_t RESERVE = size_t(1) << 36;
+    static constexpr size_t IMPORT_BATCH = 1024;
+
+    std::string directory;
+    int packFd;
+    int indexFd;
+    unsigned char* base;
+    size_t mapped;
+    size_t packSize;
+    std::vector<entry> entries;
+    std::unordered_map<uint64_t, uint32_t> byHash;
+    mutable std::mutex mutex;
+
+    static bool writeAll(int fd, const void* data, size_t n, off_t offset) {
+        const char* p = static_cast<const char*>(data);
+        while (n > 0) {
+            ssize_t written = pwrite(fd, p, n, offset);
+            if (written <= 0)
+                return false;
+            p += written;
+            n -= static_cast<size_t>(written);
+            offset += written;
+        }
+        return true;
+    }
+    // Maps the pack up to `size`; pages already mapped are left alone.
+    bool mapPack(size_t size) {
+        size_t page = static_cast<size_t>(sysconf(_SC_PAGESIZE));
+        size_t want = (size + page - 1) / page * page;
+        if (want <= mapped)
+            return true;
+        if (want > RESERVE)
+            return false;
+        void* area = mmap(base + mapped, want - mapped, PROT_READ, MAP_SHARED | MAP_FIXED, packFd, static_cast<off_t>(mapped));
+        if (area == MAP_FAILED)
+            return false;
+        mapped = want;
+        return true;
+    }
+    uint32_t addLocked(byte_view bytes, uint64_t hash, uint32_t parent, uint32_t execMicros, uint64_t coverageHash, bool& isNew) {
+        isNew = false;
+        auto found = byHash.find(hash);
+        if (found != byHash.end()) {
+            const entry& e = entries[found->second];
+            if (e.size == bytes.size() && std::memcmp(base + e.offset, bytes.data(), bytes.size()) == 0)
+                return found->second;
+        }
+        // Bytes go in first, so the index never points past the end of the pack.
+        entry e = { hash, packSize, coverageHash, static_cast<uint32_t>(bytes.size()), parent, execMicros, 0 };
+        off_t indexOffset = static_cast<off_t>(sizeof(INDEX_MAGIC) + entries.size() * sizeof(entry));
+        if (!writeAll(packFd, bytes.data(), bytes.size(), static_cast<off_t>(packSize)) || !mapPack(packSize + bytes.size()) || !writeAll(indexFd, &e, sizeof(e), indexOffset))
+            return NO_PARENT;
+        packSize += bytes.size();
+        uint32_t id = static_cast<uint32_t>(entries.size());
+        entries.push_back(e);
+        byHash.emplace(hash, id);
+        isNew = true;
+        return id;
+    }
+public:
+    corpus_store(const std::string& dir) : directory(dir), packFd(-1), indexFd(-1), base(nullptr), mapped(0), packSize(0) {};
+    corpus_store(const corpus_store&) = delete;
+    corpus_store& operator=(const corpus_store&) = delete;
+    ~corpus_store() {
+        if (base)
+            munmap(base, RESERVE);
+        if (packFd >= 0)
+            close(packFd);
+        if (indexFd >= 0)
+            close(indexFd);
+    }
+    // Opens or creates the store. Entries left half-written by a killed campaign are dropped.
+    bool load() {
+        std::lock_guard<std::mutex> lock(mutex);
+        if (base)
+            return true;
+        std::error_code ec;
+        fs::create_directories(directory, ec);
+        packFd = open((fs::path(directory) / "corpus.pack").c_str(), O_RDWR | O_CREAT | O_CLOEXEC, 0644);
+        indexFd = open((fs::path(directory) / "corpus.idx").c_str(), O_RDWR | O_CREAT | O_CLOEXEC, 0644);
+        if (packFd < 0 || indexFd < 0)
+            return false;
+        void* area = mmap(nullptr, RESERVE, PROT_NONE, MAP_PRIVATE | MAP_ANONYMOUS | MAP_NORESERVE, -1, 0);
+        if (area == MAP_FAILED)
+            return false;
+        base = static_cast<unsigned char*>(area);
+
+        struct stat packStat, indexStat;
+        if (fstat(packFd, &packStat) < 0 || fstat(indexFd, &indexStat) < 0)
+            return false;
+        uint64_t magic = 0;
+        if (indexStat.st_size < static_cast<off_t>(sizeof(magic)) || pread(indexFd, &magic, sizeof(magic), 0) != sizeof(magic) || magic != INDEX_MAGIC) {
+            magic = INDEX_MAGIC;
+            if (ftruncate(indexFd, 0) < 0 || !writeAll(indexFd, &magic, sizeof(magic), 0))
+                return false;
+            indexStat.st_size = sizeof(magic);
+        }
+        entries.resize((static_cast<size_t>(indexStat.st_size) - sizeof(magic)) / sizeof(entry));
+        if (!entries.empty() && pread(indexFd, entries.data(), entries.size() * sizeof(entry), sizeof(magic)) != static_cast<ssize_t>(entries.size() * sizeof(entry)))
+            entries.clear();
+        size_t valid = 0;
+        while (valid < entries.size() && entries[valid].offset == packSize && packSize + entries[valid].size <= static_cast<size_t>(packStat.st_size))
+            packSize += entries[valid++].size;
+        entries.resize(valid);
+        if (ftruncate(indexFd, static_cast<off_t>(sizeof(magic) + valid * sizeof(entry))) < 0 || ftruncate(packFd, static_cast<off_t>(packSize)) < 0)
+            return false;
+        if (!mapPack(packSize))
+            return false;
+        byHash.reserve(entries.size());
+        for (uint32_t id = 0; id < entries.size(); ++id)
+            byHash.emplace(entries[id].hash, id);
+        return true;
+    }
+    // Returns the id of the input, appending it unless the same bytes are already stored;
+    // NO_PARENT if the write fails.
+    uint32_t add(byte_view bytes, uint32_t parent = NO_PARENT, uint32_t execMicros = 0, uint64_t coverageHash = 0, bool* isNew = nullptr) {
+        uint64_t hash = contentHash(bytes);
+        bool added;
+        std::lock_guard<std::mutex> lock(mutex);
+        uint32_t id = addLocked(bytes, hash, parent, execMicros, coverageHash, added);
+        if (isNew)
+            *isNew = added;
+        return id;
+    }
+    // Adds every regular file of a directory, reading and hashing them on the pool in
+    // batches and storing each batch in directory order. A stamp file remembers the import,
+    // so the directory is only read again once files were added to or removed from it.
+    size_t importDirectory(const std::string& dir, worker_pool& pool) {
+        std::error_code ec;
+        fs::path stamp = fs::path(directory) / ("import-" + toHex(contentHash(byte_view(reinterpret_cast<const unsigned char*>(dir.data()), dir.size()))));
+        if (fs::exists(stamp, ec) && fs::last_write_time(dir, ec) <= fs::last_write_time(stamp, ec))
+            return 0;
+        std::vector<std::string> files;
+        for (fs::directory_iterator it(dir, ec), end; !ec && it != end; it.increment(ec))
+            if (fs::is_regular_file(it->status()))
+                files.push_back(it->path().string());
+        std::sort(files.begin(), files.end());
+
+        size_t added = 0;
+        std::vector<std::vector<unsigned char>> batch(IMPORT_BATCH);
+        std::vector<uint64_t> hashes(IMPORT_BATCH);
+        for (size_t first = 0; first < files.size(); first += IMPORT_BATCH) {
+            int count = static_cast<int>(std::min(IMPORT_BATCH, files.size() - first));
+            pool.run(count, 16, [&](int, int i) {
+                std::ifstream inFile(files[first + i], std::ios::binary);
+                batch[i].assign(std::istreambuf_iterator<char>(inFile), std::istreambuf_iterator<char>());
+                hashes[i] = contentHash(batch[i]);
+                });
+            std::lock_guard<std::mutex> lock(mutex);
+            for (int i = 0; i < count; ++i) {
+                bool isNew;
+                if (!batch[i].empty() && addLocked(batch[i], hashes[i], NO_PARENT, 0, 0, isNew) != NO_PARENT && isNew)
+                    ++added;
+            }
+        }
+        std::ofstream(stamp.string()) << dir << '\n';
+        return added;
+    }
+    // Bytes of an entry straight from the mapping; valid for the lifetime of the store.
+    byte_view view(uint32_t id) const {
+        std::lock_guard<std::mutex> lock(mutex);
+        return byte_view(base + entries[id].offset, entries[id].size);
+    }
+    entry at(uint32_t id) const {
+        std::lock_guard<std::mutex> lock(mutex);
+        return entries[id];
+    }
+    uint32_t size() const {
+        std::lock_guard<std::mutex> lock(mutex);
+        return static_cast<uint32_t>(entries.size());
+    }
+    void sync() const {
+        if (packFd >= 0)
+            fdatasync(packFd);
+        if (indexFd >= 0)
+            fdatasync(indexFd);
+    }
+};
+
+// Power schedules, after AFL++: EXPLORE spreads the mutations by speed and size only, FAST
+// also favours entries on paths few inputs take and gives more to entries the longer they
+// were fuzzed on such a path, RARE weighs path rarity alone.
+enum class power_schedule {
+    EXPLORE,
+    FAST,
+    RARE
+};
+
+static const char* scheduleName(power_schedule s) {
+    switch (s) {
+    case power_schedule::EXPLORE: return "EXPLORE";
+    case power_schedule::RARE: return "RARE";
+    default: return "FAST";
+    }
+}
+
+static bool parseSchedule(const std::string& name, power_schedule& s) {
+    for (power_schedule candidate : { power_schedule::EXPLORE, power_schedule::FAST, power_schedule::RARE }) {
+        if (name == scheduleName(candidate)) {
+            s = candidate;
+            return true;
+        }
+    }
+    return false;
+}
+
+// Decides which queue entry gets the next mutation. Every entry has an energy from its exec
+// time and size relative to the average, how many runs took its path and how many
+// mutations it already had; entries are drawn in proportion to it from an alias table, so
+// a pick is O(1). The table is rebuilt in O(n) once as many picks went by as it has entries
+// or the queue grew by an eighth, which keeps picks O(1) amortized also at 100k entries.
+// Entries added since the last rebuild take every other pick in turn until then.
+class seed_scheduler {
+    struct seed_info {
+        uint32_t execMicros;
+        uint32_t size;
+        uint32_t path;
+        uint32_t mutations;
+    };
+    power_schedule schedule;
+    std::vector<seed_info> seeds;
+    std::vector<uint32_t> pathHits;
+    uint64_t totalHits = 0;
+    // The alias table: entry i is drawn with probability threshold[i] / 2^32, else alias[i].
+    std::vector<uint64_t> threshold;
+    std::vector<uint32_t> alias;
+    std::vector<double> scaled;
+    std::vector<uint32_t> small;
+    std::vector<uint32_t> large;
+    size_t tableSize = 0;
+    size_t picksSinceBuild = 0;
+    size_t freshCursor = 0;
+
+    static constexpr uint32_t PATH_SLOTS = 1 << 18;
+    static constexpr uint32_t MUTATIONS_PER_LEVEL = 256;
+    static constexpr size_t MIN_REBUILD_PICKS = 256;
+    static constexpr double MAX_FACTOR = 32;
+    static constexpr double MAX_ENERGY = 6400;
+
+    double energy(const seed_info& s, double avgMicros, double avgSize, double avgHits) const {
+        double score = 100;
+        if (s.execMicros && avgMicros > 0) {
+            double m = s.execMicros;
+            if (m * 0.1 > avgMicros) score = 10;
+            else if (m * 0.25 > avgMicros) score = 25;
+            else if (m * 0.5 > avgMicros) score = 50;
+            else if (m * 0.75 > avgMicros) score = 75;
+            else if (m * 4 < avgMicros) score = 300;
+            else if (m * 3 < avgMicros) score = 200;
+            else if (m * 2 < avgMicros) score = 150;
+        }
+        if (s.size > 2 * avgSize)
+            score *= 0.5;
+        else if (s.size * 2 < avgSize)
+            score *= 1.5;
+        double hits = std::max(1.0, static_cast<double>(pathHits[s.path]));
+        uint32_t level = s.mutations / MUTATIONS_PER_LEVEL;
+        if (schedule == power_schedule::FAST)
+            score *= std::min(MAX_FACTOR, (level < 16 ? static_cast<double>(1u << level) : MAX_FACTOR) / hits);
+        else if (schedule == power_schedule::RARE)
+            score *= std::min(MAX_FACTOR, std::max(1.0, avgHits) / hits);
+        return std::min(MAX_ENERGY, std::max(1.0, score));
+    }
+    // Vose's method.
+    void rebuild() {
+        size_t n = seeds.size();
+        double totalMicros = 0, timed = 0, totalSize = 0;
+        for (const seed_info& s : seeds) {
+            totalMicros += s.execMicros;
+            timed += s.execMicros != 0;
+            totalSize += s.size;
+        }
+        double avgMicros = timed ? totalMicros / timed : 0, avgSize = totalSize / n, avgHits = static_cast<double>(totalHits) / n;
+        scaled.resize(n);
+        double total = 0;
+        for (size_t i = 0; i < n; ++i)
+            total += scaled[i] = energy(seeds[i], avgMicros, avgSize, avgHits);
+        threshold.assign(n, 1ull << 32);
+        alias.resize(n);
+        small.clear();
+        large.clear();
+        for (size_t i = 0; i < n; ++i) {
+            alias[i] = static_cast<uint32_t>(i);
+            scaled[i] *= n / total;
+            (scaled[i] < 1 ? small : large).push_back(static_cast<uint32_t>(i));
+        }
+        while (!small.empty() && !large.empty()) {
+            uint32_t less = small.back(), more = large.back();
+            small.pop_back();
+            threshold[less] = static_cast<uint64_t>(scaled[less] * 4294967296.0);
+            alias[less] = more;
+            scaled[more] -= 1 - scaled[less];
+            if (scaled[more] < 1) {
+                large.pop_back();
+                small.push_back(more);
+            }
+        }
+        tableSize = n;
+        picksSinceBuild = 0;
+    }
+public:
+    explicit seed_scheduler(power_schedule s) : schedule(s), pathHits(PATH_SLOTS) {};
+    void setSchedule(power_schedule s) {
+        schedule = s;
+        tableSize = 0;
+    }
+    power_schedule current() const {
+        return schedule;
+    }
+    // Appends an entry; ids follow the order of the calls. pathHash 0 is an unknown path.
+    void add(uint32_t execMicros, size_t size, uint64_t pathHash) {
+        seeds.push_back({ execMicros, static_cast<uint32_t>(std::min<size_t>(size, UINT32_MAX)), static_cast<uint32_t>(pathHash & (PATH_SLOTS - 1)), 0 });
+    }
+    // Counts a run that took this path.
+    void countPath(uint64_t pathHash) {
+        ++pathHits[pathHash & (PATH_SLOTS - 1)];
+        ++totalHits;
+    }
+    // The entry to mutate next; counts the mutation against it.
+    uint32_t next(wyrand& rng) {
+        size_t n = seeds.size();
+        if (!tableSize || picksSinceBuild >= std::max(tableSize, MIN_REBUILD_PICKS) || n - tableSize > tableSize / 8)
+            rebuild();
+        uint32_t id;
+        if ((picksSinceBuild++ & 1) && tableSize < n) {
+            id = static_cast<uint32_t>(tableSize + freshCursor++ % (n - tableSize));
+        }
+        else {
+            size_t i = rng.below(tableSize);
+            id = (rng() >> 32) < threshold[i] ? static_cast<uint32_t>(i) : alias[i];
+        }
+        if (seeds[id].mutations < UINT32_MAX)
+            seeds[id].mutations++;
+        return id;
+    }
+    size_t size() const {
+        return seeds.size();
+    }
+    // Mutation counts of the entries, for a checkpoint; path counts start over on resume.
+    std::vector<unsigned char> state() const {
+        std::vector<unsigned char> bytes(seeds.size() * sizeof(uint32_t));
+        for (size_t i = 0; i < seeds.size(); ++i)
+            std::memcpy(bytes.data() + i * sizeof(uint32_t), &seeds[i].mutations, sizeof(uint32_t));
+        return bytes;
+    }
+    // Entries the saved state does not know keep a count of 0.
+    void restore(byte_view saved) {
+        size_t n = std::min(seeds.size(), saved.size() / sizeof(uint32_t));
+        for (size_t i = 0; i < n; ++i)
+            std::memcpy(&seeds[i].mutations, saved.data() + i * sizeof(uint32_t), sizeof(uint32_t));
+        tableSize = 0;
+    }
+};
+
+// Where and as what an instance syncs; no directory means it runs alone.
+struct sync_options {
+    std::string directory;
+    std::string name;
+    bool primary = false;
+
+    bool enabled() const {
+        return !directory.empty();
+    }
+};
+
+// Shares one campaign between fuzzer processes, on one box or on several through NFS. Each
+// instance publishes under <sync>/<name>/: inputs that reached new coverage in queue/ and
+// the first input of every new crash bucket in crashes/. Every item is a file named by its
+// sequence number and renamed into place, so a reader that finds number n finds all before
+// it too. Readers keep the next number of every peer in .cursors and probe for it, so one
+// sync costs what is new and never lists a queue. The primary imports inputs and crashes
+// from every instance and publishes the inputs that are new to it again; a secondary
+// imports the primary's inputs only, so its cost does not grow with the instance count.
+// The files are read and written on a thread of its own; the exec loop runs the imports.
+class sync_client {
+public:
+    enum kind {
+        INPUT = 0,
+        CRASH = 1
+    };
+    struct item {
+        kind type;
+        std::vector<unsigned char> bytes;
+    };
+    static constexpr std::chrono::seconds INTERVAL{ 10 };
+private:
+    static constexpr size_t MAX_INBOX = 4096;
+    static constexpr const char* KIND_DIRECTORY[2] = { "queue", "crashes" };
+
+    struct peer {
+        uint64_t next[2] = { 0, 0 };
+    };
+    fs::path root;
+    fs::path own;
+    std::string name;
+    bool primary;
+    log_mask mask;
+    std::mutex mutex;
+    std::condition_variable wake;
+    bool stopping = false;
+    std::deque<item> outbox;
+    std::vector<item> inbox;
+    std::atomic<bool> imported{ false };
+    std::unordered_set<uint64_t> seen;
+    // Only the sync thread touches these.
+    uint64_t published[2] = { 0, 0 };
+    std::unordered_map<std::string, peer> peers;
+    std::string primaryName;
+    std::thread thread;
+
+    static fs::path itemPath(const fs::path& instance, int type, uint64_t seq) {
+        char number[24];
+        snprintf(number, sizeof(number), "%012llu", static_cast<unsigned long long>(seq));
+        return instance / KIND_DIRECTORY[type] / number;
+    }
+    static bool readItem(const fs::path& path, std::vector<unsigned char>& bytes) {
+        std::ifstream inFile(path.string(), std::ios::binary);
+        if (!inFile)
+            return false;
+        bytes.assign(std::istreambuf_iterator<char>(inFile), std::istreambuf_iterator<char>());
+        return true;
+    }
+    // Items are numbered from 0 without gaps, so the first free number is found by doubling
+    // and bisecting: O(log n) probes when an instance starts again.
+    static uint64_t firstFree(const fs::path& instance, int type) {
+        std::error_code ec;
+        uint64_t high = 1;
+        while (fs::exists(itemPath(instance, type, high - 1), ec))
+            high *= 2;
+        uint64_t low = high / 2;
+        while (low < high) {
+            uint64_t middle = (low + high) / 2;
+            if (fs::exists(itemPath(instance, type, middle), ec))
+                low = middle + 1;
+            else
+                high = middle;
+        }
+        return low;
+    }
+    void loadCursors() {
+        std::ifstream in((own / ".cursors").string());
+        std::string peerName;
+        uint64_t inputs, crashes;
+        while (in >> peerName >> inputs >> crashes)
+            peers[peerName] = { { inputs, crashes } };
+    }
+    void saveCursors() const {
+        std::string path = (own / ".cursors").string(), temporary = path + ".tmp";
+        {
+            std::ofstream out(temporary, std::ios::trunc);
+            for (const auto& p : peers)
+                out << p.first << ' ' << p.second.next[INPUT] << ' ' << p.second.next[CRASH] << '\n';
+            if (!out)
+                return;
+        }
+        std::rename(temporary.c_str(), path.c_str());
+    }
+    void publishAll(std::deque<item>& items) {
+        for (const item& it : items) {
+            fs::path target = itemPath(own, it.type, published[it.type]);
+            std::string temporary = (own / ".tmp").string();
+            {
+                std::ofstream out(temporary, std::ios::binary | std::ios::trunc);
+                out.write(reinterpret_cast<const char*>(it.bytes.data()), it.bytes.size());
+                if (!out) {
+                    Logger::logError(mask, "Failed to publish to ", target.string());
+                    continue;
+                }
+            }
+            if (std::rename(temporary.c_str(), target.string().c_str()) == 0)
+                published[it.type]++;
+        }
+        items.clear();
+    }
+    // Instances are the directories of the sync directory; the primary has a "primary" file.
+    std::vector<std::string> sources() {
+        std::vector<std::string> names;
+        if (!primary && !primaryName.empty())
+            return { primaryName };
+        std::error_code ec;
+        for (fs::directory_iterator it(root, ec), end; !ec && it != end; it.increment(ec)) {
+            std::string instance = it->path().filename().string();
+            if (instance == name || !fs::is_directory(it->path(), ec))
+                continue;
+            if (primary) {
+                names.push_back(instance);
+            }
+            else if (fs::exists(it->path() / "primary", ec)) {
+                primaryName = instance;
+                return { instance };
+            }
+        }
+        return names;
+    }
+    size_t importAll() {
+        size_t count = 0;
+        std::vector<unsigned char> bytes;
+        for (const std::string& source : sources()) {
+            peer& cursor = peers[source];
+            for (int type = INPUT; type <= (primary ? CRASH : INPUT); ++type) {
+                while (readItem(itemPath(root / source, type, cursor.next[type]), bytes)) {
+                    cursor.next[type]++;
+                    std::lock_guard<std::mutex> lock(mutex);
+                    if (!seen.insert(contentHash(bytes)).second)
+                        continue;
+                    inbox.push_back({ static_cast<kind>(type), bytes });
+                    imported = true;
+                    ++count;
+                    if (inbox.size() >= MAX_INBOX)
+                        return count;
+                }
+            }
+        }
+        return count;
+    }
+    void loop() {
+        std::unique_lock<std::mutex> lock(mutex);
+        for (;;) {
+            bool last = wake.wait_for(lock, INTERVAL, [this] { return stopping; });
+            std::deque<item> items;
+            items.swap(outbox);
+            lock.unlock();
+            publishAll(items);
+            size_t count = last ? 0 : importAll();
+            saveCursors();
+            if (count)
+                Logger::logProcessInfo(mask, "Sync: ", count, " new items from other instances");
+            lock.lock();
+            if (last)
+                return;
+        }
+    }
+public:
+    // Names may hold letters, digits, '-' and '_'.
+    static bool validName(const std::string& n) {
+        return !n.empty() && std::all_of(n.begin(), n.end(), [](char c) { return std::isalnum(static_cast<unsigned char>(c)) || c == '-' || c == '_'; });
+    }
+    sync_client(const std::string& dir, const std::string& instance, bool isPrimary, log_mask m) : root(dir), own(fs::path(dir) / instance), name(instance), primary(isPrimary), mask(m) {
+        std::error_code ec;
+        fs::create_directories(own / KIND_DIRECTORY[INPUT], ec);
+        fs::create_directories(own / KIND_DIRECTORY[CRASH], ec);
+        if (ec)
+            Logger::logError(mask, "Failed to create the sync directory ", own.string());
+        if (primary)
+            std::ofstream((own / "primary").string());
+        else
+            fs::remove(own / "primary", ec);
+        published[INPUT] = firstFree(own, INPUT);
+        published[CRASH] = firstFree(own, CRASH);
+        loadCursors();
+        thread = std::thread(&sync_client::loop, this);
+    }
+    // Publishes what is still queued before it returns.
+    ~sync_client() {
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+            stopping = true;
+        }
+        wake.notify_one();
+        thread.join();
+    }
+    sync_client(const sync_client&) = delete;
+    sync_client& operator=(const sync_client&) = delete;
+    bool isPrimary() const {
+        return primary;
+    }
+    // Queues an item for the next sync. It is not imported back from other instances.
+    void publish(kind type, byte_view bytes) {
+        std::lock_guard<std::mutex> lock(mutex);
+        seen.insert(contentHash(bytes));
+        outbox.push_back({ type, std::vector<unsigned char>(bytes.begin(), bytes.end()) });
+    }
+    // Whether collect() has something; one relaxed load, for the exec loop.
+    bool hasImports() const {
+        return imported.load(std::memory_order_relaxed);
+    }
+    std::vector<item> collect() {
+        std::lock_guard<std::mutex> lock(mutex);
+        std::vector<item> items;
+        items.swap(inbox);
+        imported = false;
+        return items;
+    }
+};
+
+// Exec latency histogram: bucket k counts runs of less than 2^k microseconds (the last one
+// also everything slower).
+constexpr int LATENCY_BUCKETS = 24;
+
+// Counters of one worker. Only the worker itself writes them, so a relaxed load and store
+// replaces a locked add; the aggregator may read them at any time. Each worker's counters
+// start on their own cache line.
+struct alignas(64) worker_stats {
+    std::atomic<uint64_t> execs{ 0 };
+    std::atomic<uint64_t> crashes{ 0 };
+    std::atomic<uint64_t> hangs{ 0 };
+    std::atomic<uint64_t> newCoverage{ 0 };
+    std::atomic<uint64_t> latencyMicros{ 0 };
+    std::atomic<uint64_t> latency[LATENCY_BUCKETS] = {};
+
+    static void bump(std::atomic<uint64_t>& counter, uint64_t n = 1) {
+        counter.store(counter.load(std::memory_order_relaxed) + n, std::memory_order_relaxed);
+    }
+    void countExec(uint64_t micros) {
+        int bucket = micros ? 64 - __builtin_clzll(micros) : 0;
+        bump(execs);
+        bump(latencyMicros, micros);
+        bump(latency[std::min(bucket, LATENCY_BUCKETS - 1)]);
+    }
+    void countCrash() { bump(crashes); }
+    void countHang() { bump(hangs); }
+    void countNewCoverage() { bump(newCoverage); }
+};
+
+// The campaign counters at one point in time.
+struct stats_snapshot {
+    double seconds = 0;
+    double execsPerSecond = 0;
+    uint64_t execs = 0;
+    uint64_t crashes = 0;
+    uint64_t hangs = 0;
+    uint64_t newCoverage = 0;
+    uint64_t uniqueCrashes = 0;
+    uint64_t uniqueHangs = 0;
+    uint64_t uniqueDivergences = 0;
+    uint64_t corpusSize = 0;
+    uint64_t edges = 0;
+    // Part of execs restored from a checkpoint rather than run.
+    uint64_t resumedExecs = 0;
+    uint64_t dictionarySize = 0;
+    // Costliest run kept in the perf store: CPU time and peak resident memory.
+    uint64_t slowestCpuMicros = 0;
+    uint64_t peakRssKb = 0;
+    // Cores the workers and their targets are pinned to.
+    std::vector<cpu_placement::core> placement;
+    uint64_t latencyMicros = 0;
+    uint64_t latency[LATENCY_BUCKETS] = {};
+
+    // Upper bound in microseconds of the bucket holding the given fraction of the runs.
+    uint64_t latencyPercentile(double fraction) const {
+        uint64_t rank = static_cast<uint64_t>(fraction * execs), seen = 0;
+        for (int k = 0; k < LATENCY_BUCKETS; ++k) {
+            seen += latency[k];
+            if (seen > rank)
+                return 1ull << k;
+        }
+        return execs ? 1ull << (LATENCY_BUCKETS - 1) : 0;
+    }
+};
+
+// Counters of the running campaign: one worker_stats per worker plus campaign-wide gauges
+// the algorithms set as they change. The aggregator publishes snapshots of it for the GUI.
+class campaign_stats {
+    mutable std::mutex mutex;
+    std::deque<worker_stats> workers;
+    std::chrono::steady_clock::time_point started = std::chrono::steady_clock::now();
+    stats_snapshot last;
+public:
+    std::atomic<uint64_t> uniqueCrashes{ 0 };
+    std::atomic<uint64_t> uniqueHangs{ 0 };
+    std::atomic<uint64_t> uniqueDivergences{ 0 };
+    std::atomic<uint64_t> corpusSize{ 0 };
+    std::atomic<uint64_t> edges{ 0 };
+    std::atomic<uint64_t> resumedExecs{ 0 };
+    std::atomic<uint64_t> dictionarySize{ 0 };
+    std::atomic<uint64_t> slowestCpuMicros{ 0 };
+    std::atomic<uint64_t> peakRssKb{ 0 };
+
+    static campaign_stats& global() {
+        static campaign_stats stats;
+        return stats;
+    }
+    // Starts a new campaign; no worker of the previous one may still be running.
+    void reset() {
+        std::lock_guard<std::mutex> lock(mutex);
+        workers.clear();
+        started = std::chrono::steady_clock::now();
+        last = stats_snapshot();
+        uniqueCrashes = 0;
+        uniqueHangs = 0;
+        uniqueDivergences = 0;
+        corpusSize = 0;
+        edges = 0;
+        resumedExecs = 0;
+        dictionarySize = 0;
+        slowestCpuMicros = 0;
+        peakRssKb = 0;
+    }
+    // Counters for one more worker; they live until the next reset.
+    worker_stats& attach() {
+        std::lock_guard<std::mutex> lock(mutex);
+        workers.emplace_back();
+        return workers.back();
+    }
+    stats_snapshot collect() const {
+        stats_snapshot s;
+        std::lock_guard<std::mutex> lock(mutex);
+        s.seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - started).count();
+        for (const worker_stats& w : workers) {
+            s.execs += w.execs.load(std::memory_order_relaxed);
+            s.crashes += w.crashes.load(std::memory_order_relaxed);
+            s.hangs += w.hangs.load(std::memory_order_relaxed);
+            s.newCoverage += w.newCoverage.load(std::memory_order_relaxed);
+            s.latencyMicros += w.latencyMicros.load(std::memory_order_relaxed);
+            for (int k = 0; k < LATENCY_BUCKETS; ++k)
+                s.latency[k] += w.latency[k].load(std::memory_order_relaxed);
+        }
+        s.uniqueCrashes = uniqueCrashes;
+        s.uniqueHangs = uniqueHangs;
+        s.uniqueDivergences = uniqueDivergences;
+        s.corpusSize = corpusSize;
+        s.edges = edges;
+        s.resumedExecs = resumedExecs;
+        s.dictionarySize = dictionarySize;
+        s.slowestCpuMicros = slowestCpuMicros;
+        s.peakRssKb = peakRssKb;
+        s.placement = cpu_placement::global().cores();
+        return s;
+    }
+    void publish(const stats_snapshot& s) {
+        std::lock_guard<std::mutex> lock(mutex);
+        last = s;
+    }
+    // The latest snapshot of the aggregator.
+    stats_snapshot published() const {
+        std::lock_guard<std::mutex> lock(mutex);
+        return last;
+    }
+};
+
+// Samples the campaign counters at a fixed rate on its own thread. Every sample goes back
+// into campaign_stats for the GUI, into <dir>/fuzzer_stats as "key : value" lines, into a
+// Prometheus textfile-collector file (fuzzer.prom in $FUZZER_PROM_DIR, else in dir) and to
+// stdout as one status line. Files are replaced by rename, so readers never see half of one.
+class stats_aggregator {
+    campaign_stats& stats;
+    std::string statusPath;
+    std::string promPath;
+    std::chrono::milliseconds interval;
+    std::function<void(const stats_snapshot&)> progress;
+    std::time_t startTime = std::time(nullptr);
+    uint64_t lastExecs = 0;
+    double lastSeconds = 0;
+    std::mutex mutex;
+    std::condition_variable wake;
+    bool stopping = false;
+    std::thread thread;
+
+    static void replaceFile(const std::string& path, const std::string& text) {
+        std::string temporary = path + ".tmp";
+        {
+            std::ofstream out(temporary, std::ios::trunc);
+            if (!(out << text))
+                return;
+        }
+        std::rename(temporary.c_str(), path.c_str());
+    }
+    static std::string number(double value) {
+        char text[32];
+        snprintf(text, sizeof(text), "%.6g", value);
+        return text;
+    }
+    std::string statusText(const stats_snapshot& s) const {
+        std::string text;
+        auto line = [&](const char* key, const std::string& value) {
+            char name[24];
+            snprintf(name, sizeof(name), "%-19s", key);
+            text += name;
+            text += ": " + value + "\n";
+        };
+        line("start_time", std::to_string(startTime));
+        line("last_update", std::to_string(std::time(nullptr)));
+        line("run_time", number(s.seconds));
+        line("execs_done", std::to_string(s.execs));
+        line("execs_per_sec", number(s.execsPerSecond));
+        line("crashes", std::to_string(s.crashes));
+        line("unique_crashes", std::to_string(s.uniqueCrashes));
+        line("hangs", std::to_string(s.hangs));
+        line("unique_hangs", std::to_string(s.uniqueHangs));
+        line("unique_diffs", std::to_string(s.uniqueDivergences));
+        line("new_coverage", std::to_string(s.newCoverage));
+        line("corpus_size", std::to_string(s.corpusSize));
+        line("edges_found", std::to_string(s.edges));
+        line("dictionary_size", std::to_string(s.dictionarySize));
+        line("exec_p50_us", std::to_string(s.latencyPercentile(0.5)));
+        line("exec_p99_us", std::to_string(s.latencyPercentile(0.99)));
+        line("slowest_cpu_us", std::to_string(s.slowestCpuMicros));
+        line("peak_rss_kb", std::to_string(s.peakRssKb));
+        std::string cores;
+        for (const cpu_placement::core& c : s.placement)
+            cores += (cores.empty() ? "" : " ") + std::to_string(c.cpu) + (c.node >= 0 ? "@node" + std::to_string(c.node) : "");
+        line("cpu_placement", cores.empty() ? "none" : cores);
+        return text;
+    }
+    std::string prometheusText(const stats_snapshot& s) const {
+        std::string text;
+        auto metric = [&](const char* name, const char* type, const char* help, const std::string& value) {
+            text += std::string("# HELP ") + name + " " + help + "\n# TYPE " + name + " " + type + "\n" + name + " " + value + "\n";
+        };
+        metric("fuzzer_execs_total", "counter", "Target executions.", std::to_string(s.execs));
+        metric("fuzzer_crashes_total", "counter", "Executions that crashed the target.", std::to_string(s.crashes));
+        metric("fuzzer_hangs_total", "counter", "Executions that timed out.", std::to_string(s.hangs));
+        metric("fuzzer_new_coverage_total", "counter", "Executions that reached new coverage.", std::to_string(s.newCoverage));
+        metric("fuzzer_unique_crashes", "gauge", "Crash buckets.", std::to_string(s.uniqueCrashes));
+        metric("fuzzer_unique_hangs", "gauge", "Hang buckets.", std::to_string(s.uniqueHangs));
+        metric("fuzzer_unique_divergences", "gauge", "Divergence buckets of a differential campaign.", std::to_string(s.uniqueDivergences));
+        metric("fuzzer_corpus_size", "gauge", "Inputs in the corpus.", std::to_string(s.corpusSize));
+        metric("fuzzer_edges_found", "gauge", "Edges reached so far.", std::to_string(s.edges));
+        metric("fuzzer_dictionary_tokens", "gauge", "Tokens in the dictionary.", std::to_string(s.dictionarySize));
+        metric("fuzzer_slowest_cpu_seconds", "gauge", "CPU time of the slowest input kept.", number(s.slowestCpuMicros / 1e6));
+        metric("fuzzer_peak_rss_bytes", "gauge", "Peak resident memory of the hungriest input kept.", std::to_string(s.peakRssKb * 1024));
+        metric("fuzzer_pinned_cpus", "gauge", "Cores the workers and their targets are pinned to.", std::to_string(s.placement.size()));
+        metric("fuzzer_execs_per_second", "gauge", "Executions per second over the last interval.", number(s.execsPerSecond));
+        metric("fuzzer_start_time_seconds", "gauge", "Unix time the campaign started.", std::to_string(startTime));
+        metric("fuzzer_last_update_seconds", "gauge", "Unix time of this sample.", std::to_string(std::time(nullptr)));
+
+        text += "# HELP fuzzer_exec_duration_seconds Duration of one target execution.\n# TYPE fuzzer_exec_duration_seconds histogram\n";
+        uint64_t cumulative = 0;
+        for (int k = 0; k < LATENCY_BUCKETS - 1; ++k) {
+            cumulative += s.latency[k];
+            text += "fuzzer_exec_duration_seconds_bucket{le=\"" + number((1ull << k) / 1e6) + "\"} " + std::to_string(cumulative) + "\n";
+        }
+        text += "fuzzer_exec_duration_seconds_bucket{le=\"+Inf\"} " + std::to_string(s.execs) + "\n";
+        text += "fuzzer_exec_duration_seconds_sum " + number(s.latencyMicros / 1e6) + "\n";
+        text += "fuzzer_exec_duration_seconds_count " + std::to_string(s.execs) + "\n";
+
+        text += "# HELP fuzzer_pinned_cpu A core the campaign holds, with its NUMA node.\n# TYPE fuzzer_pinned_cpu gauge\n";
+        for (const cpu_placement::core& c : s.placement)
+            text += "fuzzer_pinned_cpu{cpu=\"" + std::to_string(c.cpu) + "\",node=\"" + (c.node >= 0 ? std::to_string(c.node) : "") + "\"} 1\n";
+        return text;
+    }
+    void sample() {
+        stats_snapshot s = stats.collect();
+        // A resume may be half applied while sampling; such a sample reports no rate.
+        uint64_t executed = s.execs > s.resumedExecs ? s.execs - s.resumedExecs : 0;
+        if (s.seconds > lastSeconds && executed >= lastExecs)
+            s.execsPerSecond = (executed - lastExecs) / (s.seconds - lastSeconds);
+        lastExecs = executed;
+        lastSeconds = s.seconds;
+        stats.publish(s);
+        if (progress)
+            progress(s);
+        replaceFile(statusPath, statusText(s));
+        replaceFile(promPath, prometheusText(s));
+        char line[256];
+        snprintf(line, sizeof(line), "[%7.1fs] execs %llu (%.0f/s), crashes %llu (%llu unique), hangs %llu (%llu unique), corpus %llu, edges %llu\n",
+            s.seconds, static_cast<unsigned long long>(s.execs), s.execsPerSecond,
+            static_cast<unsigned long long>(s.crashes), static_cast<unsigned long long>(s.uniqueCrashes),
+            static_cast<unsigned long long>(s.hangs), static_cast<unsigned long long>(s.uniqueHangs),
+            static_cast<unsigned long long>(s.corpusSize), static_cast<unsigned long long>(s.edges));
+        std::cout << line << std::flush;
+    }
+    void loop() {
+        std::unique_lock<std::mutex> lock(mutex);
+        while (!wake.wait_for(lock, interval, [this] { return stopping; })) {
+            lock.unlock();
+            sample();
+            lock.lock();
+        }
+    }
+public:
+    // progress, if given, is called with every sample on the aggregator thread.
+    stats_aggregator(campaign_stats& s, const std::string& dir, std::function<void(const stats_snapshot&)> p = nullptr, std::chrono::milliseconds i = std::chrono::milliseconds(1000)) : stats(s), interval(i), progress(std::move(p)) {
+        std::error_code ec;
+        fs::create_directories(dir, ec);
+        statusPath = (fs::path(dir) / "fuzzer_stats").string();
+        const char* promDir = std::getenv("FUZZER_PROM_DIR");
+        if (promDir && *promDir)
+            fs::create_directories(promDir, ec);
+        promPath = (fs::path(promDir && *promDir ? promDir : dir) / "fuzzer.prom").string();
+        thread = std::thread(&stats_aggregator::loop, this);
+    }
+    // Takes one last sample, so the files end up with the totals of the campaign.
+    ~stats_aggregator() {
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+            stopping = true;
+        }
+        wake.notify_one();
+        thread.join();
+        sample();
+    }
+    stats_aggregator(const stats_aggregator&) = delete;
+    stats_aggregator& operator=(const stats_aggregator&) = delete;
+};
+
+// Lets a front end pause or stop the running campaign from another thread. Workers call
+// proceed() before every exec; unless the campaign is paused it only reads two atomics.
+class campaign_control {
+    std::mutex mutex;
+    std::condition_variable changed;
+    std::atomic<bool> stopping{ false };
+    std::atomic<bool> pausing{ false };
+public:
+    static campaign_control& global() {
+        static campaign_control control;
+        return control;
+    }
+    void reset() {
+        std::lock_guard<std::mutex> lock(mutex);
+        stopping = false;
+        pausing = false;
+    }
+    // Only sets a flag, so a signal handler may call it; paused workers notice within 100 ms.
+    void requestStop() {
+        stopping.store(true);
+    }
+    void stop() {
+        std::lock_guard<std::mutex> lock(mutex);
+        stopping = true;
+        changed.notify_all();
+    }
+    void pause() {
+        pausing = true;
+    }
+    void resume() {
+        std::lock_guard<std::mutex> lock(mutex);
+        pausing = false;
+        changed.notify_all();
+    }
+    bool paused() const {
+        return pausing;
+    }
+    bool stopped() const {
+        return stopping;
+    }
+    // Blocks while the campaign is paused; false once it should stop.
+    bool proceed() {
+        if (pausing.load(std::memory_order_relaxed)) {
+            std::unique_lock<std::mutex> lock(mutex);
+            while (pausing && !stopping)
+                changed.wait_for(lock, std::chrono::milliseconds(100));
+        }
+        return !stopping.load(std::memory_order_relaxed);
+    }
+};
+
+// Campaign state that is not on disk already: where the algorithm is, its random generators,
+// the virgin map and the counters. The corpus and the crash and hang indexes are stored on
+// their own and only synced when a checkpoint is written, so a checkpoint is one small
+// write, an fsync and a rename. A hash of the contents detects a torn file.
+class checkpoint {
+    std::string path;
+    std::vector<unsigned char> data;
+    size_t position = 0;
+    bool failed = false;
+
+    static constexpr uint64_t MAGIC = 0x3254504b435a5546ull;
+public:
+    static constexpr std::chrono::seconds INTERVAL{ 30 };
+
+    explicit checkpoint(const std::string& dir) : path((fs::path(dir) / "checkpoint").string()) {};
+    const std::string& file() const {
+        return path;
+    }
+    void begin(const std::string& algorithm) {
+        data.clear();
+        put(MAGIC);
+        put(byte_view(reinterpret_cast<const unsigned char*>(algorithm.data()), algorithm.size()));
+    }
+    void put(uint64_t value) {
+        unsigned char bytes[8];
+        std::memcpy(bytes, &value, 8);
+        data.insert(data.end(), bytes, bytes + 8);
+    }
+    void put(byte_view bytes) {
+        put(static_cast<uint64_t>(bytes.size()));
+        data.insert(data.end(), bytes.begin(), bytes.end());
+    }
+    bool commit() {
+        put(contentHash(data));
+        std::string temporary = path + ".tmp";
+        int fd = open(temporary.c_str(), O_WRONLY | O_CREAT | O_TRUNC | O_CLOEXEC, 0644);
+        if (fd < 0)
+            return false;
+        bool written = write(fd, data.data(), data.size()) == static_cast<ssize_t>(data.size()) && fdatasync(fd) == 0;
+        close(fd);
+        return written && std::rename(temporary.c_str(), path.c_str()) == 0;
+    }
+    // Reads the checkpoint an algorithm of this name wrote; false if there is none.
+    bool load(const std::string& algorithm) {
+        std::ifstream inFile(path, std::ios::binary);
+        data.assign(std::istreambuf_iterator<char>(inFile), std::istreambuf_iterator<char>());
+        position = 0;
+        failed = false;
+        if (data.size() < 16)
+            return false;
+        uint64_t hash;
+        std::memcpy(&hash, data.data() + data.size() - 8, 8);
+        data.resize(data.size() - 8);
+        if (hash != contentHash(data) || get() != MAGIC)
+            return false;
+        std::vector<unsigned char> name = getBytes();
+        return good() && std::string(name.begin(), name.end()) == algorithm;
+    }
+    uint64_t get() {
+        uint64_t value = 0;
+        if (position + 8 > data.size()) {
+            failed = true;
+            return 0;
+        }
+        std::memcpy(&value, data.data() + position, 8);
+        position += 8;
+        return value;
+    }
+    std::vector<unsigned char> getBytes() {
+        uint64_t size = get();
+        if (failed || size > data.size() - position) {
+            failed = true;
+            return {};
+        }
+        position += size;
+        return std::vector<unsigned char>(data.begin() + (position - size), data.begin() + position);
+    }
+    // False once a read ran past the end.
+    bool good() const {
+        return !failed;
+    }
+};
+
+// Tokens for the mutators, deduplicated and capped. Writers add under a lock; the mutators
+// hold an immutable snapshot and pick up a new one when the version changes.
+class dictionary {
+    mutable std::mutex mutex;
+    std::unordered_set<uint64_t> known;
+    std::shared_ptr<const token_list> current = std::make_shared<token_list>();
+    std::atomic<uint64_t> revision{ 0 };
+public:
+    static constexpr size_t MAX_TOKENS = 4096;
+    static constexpr size_t MAX_TOKEN_SIZE = 64;
+
+    // Adds the tokens it does not have yet; returns how many that were.
+    size_t add(const token_list& tokens) {
+        std::lock_guard<std::mutex> lock(mutex);
+        std::shared_ptr<token_list> next;
+        for (const dictionary_token& token : tokens) {
+            const token_list& list = next ? *next : *current;
+            if (token.value.empty() || token.value.size() > MAX_TOKEN_SIZE || list.size() >= MAX_TOKENS)
+                continue;
+            uint64_t key = contentHash(token.value) ^ splitmix64(contentHash(token.match));
+            if (!known.insert(key).second)
+                continue;
+            if (!next)
+                next = std::make_shared<token_list>(*current);
+            next->push_back(token);
+        }
+        if (!next)
+            return 0;
+        size_t added = next->size() - current->size();
+        current = std::move(next);
+        revision.fetch_add(1, std::memory_order_release);
+        campaign_stats::global().dictionarySize = current->size();
+        return added;
+    }
+    std::shared_ptr<const token_list> snapshot() const {
+        std::lock_guard<std::mutex> lock(mutex);
+        return current;
+    }
+    // Changes whenever tokens were added; cheap enough to poll from the exec loop.
+    uint64_t version() const {
+        return revision.load(std::memory_order_acquire);
+    }
+};
+
+// Fills a dictionary on its own thread, at a lower priority than the workers: first with the
+// strings in the target binary's read-only data, then with the comparisons the target makes
+// on the inputs it is handed, each run once more with comparison tracing on its own
+// executor. Inputs are dropped while it is behind, so submit() never holds up a worker.
+class dictionary_harvester {
+    std::string programPath;
+    dictionary& tokens;
+    unsigned timeoutMs;
+    log_mask mask;
+    std::mutex mutex;
+    std::condition_variable wake;
+    std::deque<std::vector<unsigned char>> pending;
+    bool stopping = false;
+    std::thread thread;
+
+    static constexpr size_t MAX_PENDING = 64;
+    static constexpr size_t MIN_STRING = 4;
+    static constexpr size_t MAX_STRINGS = 1024;
+
+    static bool printable(unsigned char c) {
+        return (c >= 0x20 && c < 0x7f) || c == '\t';
+    }
+    // Runs of printable characters in [begin, end).
+    static void addStrings(const unsigned char* begin, const unsigned char* end, token_list& out) {
+        const unsigned char* run = begin;
+        for (const unsigned char* p = begin; p <= end && out.size() < MAX_STRINGS; ++p) {
+            if (p < end && printable(*p))
+                continue;
+            size_t length = p - run;
+            if (length >= MIN_STRING && length <= dictionary::MAX_TOKEN_SIZE)
+                out.push_back({ std::vector<unsigned char>(run, p), {} });
+            run = p + 1;
+        }
+    }
+    // Strings in the .rodata of an ELF executable or library; the whole file if it is no ELF.
+    static token_list binaryStrings(const std::string& path) {
+        token_list out;
+        std::ifstream inFile(path, std::ios::binary);
+        std::vector<unsigned char> image((std::istreambuf_iterator<char>(inFile)), std::istreambuf_iterator<char>());
+        const unsigned char* base = image.data();
+        if (image.size() < sizeof(Elf64_Ehdr) || std::memcmp(base, ELFMAG, SELFMAG) != 0 || base[EI_CLASS] != ELFCLASS64) {
+            addStrings(base, base + image.size(), out);
+            return out;
+        }
+        Elf64_Ehdr header;
+        std::memcpy(&header, base, sizeof(header));
+        auto section = [&](size_t k, Elf64_Shdr& s) {
+            size_t at = header.e_shoff + k * sizeof(Elf64_Shdr);
+            if (header.e_shentsize != sizeof(Elf64_Shdr) || at + sizeof(Elf64_Shdr) > image.size())
+                return false;
+            std::memcpy(&s, base + at, sizeof(s));
+            return s.sh_type == SHT_NOBITS || s.sh_offset + s.sh_size <= image.size();
+        };
+        Elf64_Shdr names;
+        if (!section(header.e_shstrndx, names))
+            return out;
+        for (size_t k = 0; k < header.e_shnum; ++k) {
+            Elf64_Shdr s;
+            if (!section(k, s) || s.sh_type != SHT_PROGBITS || s.sh_name >= names.sh_size)
+                continue;
+            const char* name = reinterpret_cast<const char*>(base + names.sh_offset + s.sh_name);
+            if (strnlen(name, names.sh_size - s.sh_name) < names.sh_size - s.sh_name && std::strcmp(name, ".rodata") == 0)
+                addStrings(base + s.sh_offset, base + s.sh_offset + s.sh_size, out);
+        }
+        return out;
+    }
+    static std::vector<unsigned char> operandBytes(uint64_t value, size_t size, bool bigEndian) {
+        std::vector<unsigned char> bytes(size);
+        for (size_t k = 0; k < size; ++k)
+            bytes[bigEndian ? size - 1 - k : k] = static_cast<unsigned char>(value >> (8 * k));
+        return bytes;
+    }
+    // Tokens from one comparison, in both byte orders. An operand whose bytes occur in the
+    // input is taken to come from there, and the other operand is a token that replaces it.
+    // A constant is kept on its own when its partner is not found, unless it is 0 or ~0.
+    // Single bytes occur anywhere, so they only make tokens of their own.
+    static void addComparison(const cmp_entry& e, byte_view input, token_list& out) {
+        size_t size = e.size;
+        if (size != 1 && size != 2 && size != 4 && size != 8)
+            return;
+        uint64_t ones = size == 8 ? ~0ull : (1ull << (8 * size)) - 1;
+        bool constant = (e.flags & CMP_CONST) != 0;
+        for (int order = 0; order < (size > 1 ? 2 : 1); ++order) {
+            for (int side = 0; side < (constant ? 1 : 2); ++side) {
+                uint64_t value = side ? e.second : e.first, match = side ? e.first : e.second;
+                std::vector<unsigned char> valueBytes = operandBytes(value, size, order), matchBytes = operandBytes(match, size, order);
+                if (size > 1 && memmem(input.data(), input.size(), matchBytes.data(), size))
+                    out.push_back({ std::move(valueBytes), std::move(matchBytes) });
+                else if (constant && value != 0 && value != ones)
+                    out.push_back({ std::move(valueBytes), {} });
+            }
+        }
+    }
+    void loop() {
+        setpriority(PRIO_PROCESS, static_cast<id_t>(syscall(SYS_gettid)), 10);
+        size_t found = tokens.add(binaryStrings(programPath));
+        Logger::logProcessInfo(mask, "Dictionary: ", found, " strings from ", programPath);
+
+        scratch_file input("cmp");
+        cmp_log comparisons;
+        if (!input.valid() || !comparisons.valid())
+            return;
+        std::unique_ptr<executor> target = makeExecutor(programPath, input.path(), mask, nullptr, &comparisons);
+        target->setTimeout(timeoutMs);
+        for (;;) {
+            std::vector<unsigned char> data;
+            {
+                std::unique_lock<std::mutex> lock(mutex);
+                wake.wait(lock, [this] { return stopping || !pending.empty(); });
+                if (stopping)
+                    return;
+                data = std::move(pending.front());
+                pending.pop_front();
+            }
+            if (!input.write(data) || target->run().status == exec_status::TIMEOUT)
+                continue;
+            token_list found;
+            for (size_t k = 0; k < comparisons.size(); ++k)
+                addComparison(comparisons[k], data, found);
+            tokens.add(found);
+        }
+    }
+public:
+    dictionary_harvester(const std::string& program, dictionary& d, unsigned timeout, log_mask m) : programPath(program), tokens(d), timeoutMs(timeout), mask(m) {
+        thread = std::thread(&dictionary_harvester::loop, this);
+    }
+    ~dictionary_harvester() {
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+            stopping = true;
+        }
+        wake.notify_one();
+        thread.join();
+    }
+    dictionary_harvester(const dictionary_harvester&) = delete;
+    dictionary_harvester& operator=(const dictionary_harvester&) = delete;
+    // Queues an input to harvest; false if the queue was full and it was dropped.
+    bool submit(byte_view data) {
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+            if (stopping || pending.size() >= MAX_PENDING)
+                return false;
+            pending.emplace_back(data.begin(), data.end());
+        }
+        wake.notify_one();
+        return true;
+    }
+};
+
+class algorithm {
+protected:
+    virtual void execute(log_mask mask) = 0;
+
+    // Everything a pool worker touches in the hot loop; nothing here is shared between workers.
+    struct alignas(64) worker_context {
+        std::unique_ptr<scratch_file> input;
+        std::unique_ptr<coverage_map> coverage;
+        std::unique_ptr<executor> target;
+        jpgManager mutationEngine;
+        wyrand rng;
+        worker_stats* stats = nullptr;
+        long long execs = 0;
+    };
+
+    // One context per worker of the pool, each set up on its worker's own thread: memory it
+    // touches first is local to the worker's core, and the processes its executor starts
+    // inherit that core. Scratch files are named prefix<k>; the random generators of worker
+    // k are seeded from seed + 2k and seed + 2k + 1. Empty if a context could not be made.
+    static std::vector<std::unique_ptr<worker_context>> makeContexts(worker_pool& pool, const std::string& prefix, const std::string& programPath, bool withCoverage, unsigned memoryLimitMb, uint64_t seed, log_mask mask) {
+        std::vector<std::unique_ptr<worker_context>> contexts(pool.size());
+        std::atomic<bool> ready{ true };
+        pool.each([&](int j) {
+            std::unique_ptr<worker_context> ctx(new worker_context);
+            ctx->input.reset(new scratch_file(prefix + std::to_string(j)));
+            if (!ctx->input->valid()) {
+                ready = false;
+                return;
+            }
+            if (withCoverage) {
+                ctx->coverage.reset(new coverage_map);
+                if (!ctx->coverage->valid())
+                    ctx->coverage.reset();
+            }
+            ctx->target = makeExecutor(programPath, ctx->input->path(), mask, ctx->coverage.get(), nullptr, memoryLimitMb);
+            ctx->stats = &campaign_stats::global().attach();
+            ctx->rng.seed(splitmix64(seed + 2 * j));
+            ctx->mutationEngine.setSeed(splitmix64(seed + 2 * j + 1));
+            contexts[j] = std::move(ctx);
+            });
+        if (!ready) {
+            Logger::logError(mask, "Failed to create the input file for the target");
+            contexts.clear();
+        }
+        return contexts;
+    }
+
+    static constexpr unsigned CALIBRATION_RUNS = 25;
+    static constexpr unsigned CALIBRATION_TIMEOUT_MS = 10000;
+    static constexpr unsigned MIN_TIMEOUT_MS = 10;
+
+    // Sets the timeout of the target: the one the user gave, or 5x the p99 exec time of the
+    // sample (at least MIN_TIMEOUT_MS). Returns 0 if the sample itself hangs the target.
+    static unsigned calibrateTimeout(executor& target, scratch_file& input, byte_view sample, unsigned requested, log_mask mask) {
+        if (requested) {
+            target.setTimeout(requested);
+            return requested;
+        }
+        target.setTimeout(CALIBRATION_TIMEOUT_MS);
+        input.write(sample.data(), sample.size());
+        std::vector<long long> micros;
+        // The first run is not measured, it may also have to start the fork server.
+        for (unsigned k = 0; k <= CALIBRATION_RUNS; ++k) {
+            auto start = std::chrono::steady_clock::now();
+            exec_result result = target.run();
+            if (result.status == exec_status::TIMEOUT) {
+                Logger::logError(mask, "The sample hangs the target for more than ", CALIBRATION_TIMEOUT_MS, " ms");
+                return 0;
+            }
+            if (k > 0)
+                micros.push_back(std::chrono::duration_cast<std::chrono::microseconds>(std::chrono::steady_clock::now() - start).count());
+        }
+        std::sort(micros.begin(), micros.end());
+        long long p99 = micros[(micros.size() * 99 + 99) / 100 - 1];
+        unsigned ms = std::max(MIN_TIMEOUT_MS, static_cast<unsigned>((5 * p99 + 999) / 1000));
+        target.setTimeout(ms);
+        Logger::logProcessInfo(mask, "Timeout set to ", ms, " ms, p99 exec time of the sample ", p99, " us");
+        return ms;
+    }
+
+    // Logs the outcome of one run and tells whether it crashed. Crashes and hangs go into
+    // their buckets; only the first input of a bucket is saved.
+    static bool handleResult(const exec_result& result, crash_index& crashes, crash_index& hangs, const std::vector<unsigned char>& input, log_mask mask) {
+        switch (result.status) {
+        case exec_status::ERROR:
+            Logger::logError(mask, "Failed to run the target: ", result.error);
+            return false;
+        case exec_status::OK:
+            Logger::logProcessInfo(mask, "Process exited with code: ", result.exitCode);
+            return false;
+        case exec_status::TIMEOUT: {
+            crash_index::outcome bucket = hangs.record(result, input);
+            if (bucket.isNew)
+                Logger::logUnexpected(mask, "Process timed out and was killed. New hang, saving file: ", bucket.file);
+            else
+                Logger::logUnexpected(mask, "Process timed out and was killed. Hang ", bucket.file, ", hit ", bucket.hits);
+            return false;
+        }
+        default:
+            break;
+        }
+        crash_index::outcome bucket = crashes.record(result, input);
+        if (!result.sanitizer.empty()) {
+            std::string report = result.sanitizer + ": " + result.bugType;
+            if (result.accessSize)
+                report += std::string(result.writeAccess ? " (WRITE" : " (READ") + " of size " + std::to_string(result.accessSize) + ")";
+            if (!result.topFrame.empty())
+                report += " in " + result.topFrame;
+            if (bucket.isNew)
+                Logger::logCrash(mask, report, ". New bucket, saving file: ", bucket.file);
+            else
+                Logger::logCrash(mask, report, ". Bucket ", bucket.file, ", hit ", bucket.hits);
+        }
+        else if (result.status == exec_status::CRASH) {
+            if (bucket.isNew)
+                Logger::logCrash(mask, "Process was terminated by signal ", result.signal, " (", signalName(result.signal), ") at pc ", log_hex{ result.pc }, ". New bucket, saving file: ", bucket.file);
+            else
+                Logger::logCrash(mask, "Process was terminated by signal ", result.signal, " (", signalName(result.signal), ") at pc ", log_hex{ result.pc }, ". Bucket ", bucket.file, ", hit ", bucket.hits);
+        }
+        else if (bucket.isNew) {
+            Logger::logUnexpected(mask, "Process crashed or terminated unexpectedly. New bucket, saving file: ", bucket.file);
+        }
+        else {
+            Logger::logUnexpected(mask, "Process crashed or terminated unexpectedly. Bucket ", bucket.file, ", hit ", bucket.hits);
+        }
+        return true;
+    }
+    // Opens the campaign corpus and adds the sample to it: one file, or every file of a directory.
+    static bool seedCorpus(corpus_store& corpus, const std::string& sample, log_mask mask) {
+        if (!corpus.load()) {
+            Logger::logError(mask, "Failed to open the corpus in ", corpusDirectory(sample));
+            return false;
+        }
+        uint32_t before = corpus.size();
+        if (fs::is_directory(sample)) {
+            worker_pool pool;
+            corpus.importDirectory(sample, pool);
+        }
+        else {
+            std::ifstream inFile(sample, std::ios::binary);
+            if (!inFile) {
+                Logger::logError(mask, "Failed to open input file: ", sample);
+            }
+            else {
+                std::vector<unsigned char> bytes((std::istreambuf_iterator<char>(inFile)), std::istreambuf_iterator<char>());
+                corpus.add(bytes);
+            }
+        }
+        Logger::logProcessInfo(mask, "Corpus: ", corpus.size(), " inputs, ", corpus.size() - before, " new");
+        if (corpus.size() == 0) {
+            Logger::logError(mask, "The corpus is empty");
+            return false;
+        }
+        return true;
+    }
+    // Opens the crash and hang buckets and the corpus of the sample, and picks the random
+    // seed if none was given. False if there is nothing to fuzz.
+    static bool openCampaign(crash_index& crashes, crash_index& hangs, corpus_store& corpus, const std::string& sample, uint64_t& seed, log_mask mask) {
+        if (!crashes.load())
+            Logger::logError(mask, "Failed to create the crash directory: ", crashDirectory(sample));
+        if (!hangs.load())
+            Logger::logError(mask, "Failed to create the hang directory: ", hangDirectory(sample));
+        if (!seedCorpus(corpus, sample, mask))
+            return false;
+        if (!seed)
+            seed = randomSeed();
+        Logger::logProcessInfo(mask, "Random seed: ", seed);
+        return true;
+    }
+    // Syncs the corpus and saves the crash and hang indexes. A checkpoint does this before
+    // it is written, so everything it refers to is on disk.
+    static void flushCampaign(corpus_store& corpus, crash_index& crashes, crash_index& hangs) {
+        corpus.sync();
+        crashes.save();
+        hangs.save();
+    }
 };
 
+// Mutates the corpus over and over. If the target is instrumented, every input that
+// reaches new coverage is added to the corpus and joins the queue.
 class dumb_algorithm : algorithm {
     std::string programPath;
     std::string exampleQuery;
     int iteration_count;
     int current_mutation;
+    // Corpus entries are parsed the first time they are picked.
+    struct queue_entry {
+        uint32_t id;
+        bool parsed;
+        jpeg_index index;
+    };
+    std::vector<queue_entry> queue;
+    virgin_map virgin;
+    crash_index crashes;
+    crash_index hangs;
+    corpus_store corpus;
+    uint64_t seed;
+    unsigned timeoutMs;
+    bool resume;
+    power_schedule schedule;
+    sync_options syncing;
+    perf_store perf;
+    unsigned memoryLimitMb;
+    perf_objective objective;
+
+    queue_entry& pick(size_t n) {
+        queue_entry& entry = queue[n];
+        if (!entry.parsed) {
+            entry.index = jpeg_index::parse(corpus.view(entry.id));
+            entry.parsed = true;
+        }
+        return entry;
+    }
+    // Records where the loop is.
+    void saveCheckpoint(checkpoint& state, const worker_stats& counters, bool guided, int next, const seed_scheduler& scheduler, const wyrand& gen, const jpgManager& mutationEngine, log_mask mask) {
+        flushCampaign(corpus, crashes, hangs);
+        state.begin("DUMB");
+        state.put(static_cast<uint64_t>(next));
+        state.put(static_cast<uint64_t>(current_mutation));
+        state.put(scheduler.state());
+        state.put(gen.state());
+        state.put(mutationEngine.rngState());
+        state.put(timeoutMs);
+        state.put(guided);
+        state.put(counters.execs.load());
+        state.put(counters.crashes.load());
+        state.put(counters.hangs.load());
+        state.put(counters.newCoverage.load());
+        state.put(virgin.raw());
+        if (!state.commit())
+            Logger::logError(mask, "Failed to write the checkpoint ", state.file());
+    }
+    // The queue is rebuilt from the corpus, so nothing has to run again.
+    bool resumeFrom(checkpoint& state, worker_stats& counters, executor& target, bool& guided, int& next, seed_scheduler& scheduler, wyrand& gen, jpgManager& mutationEngine) {
+        if (!state.load("DUMB"))
+            return false;
+        uint64_t savedNext = state.get(), savedMutation = state.get();
+        std::vector<unsigned char> mutations = state.getBytes();
+        uint64_t genState = state.get(), engineState = state.get(), savedTimeout = state.get(), savedGuided = state.get();
+        uint64_t execs = state.get(), crashCount = state.get(), hangCount = state.get(), newCoverage = state.get();
+        std::vector<unsigned char> bits = state.getBytes();
+        if (!state.good() || !savedTimeout || !virgin.restore(bits))
+            return false;
+        next = static_cast<int>(savedNext);
+        current_mutation = static_cast<int>(savedMutation);
+        scheduler.restore(mutations);
+        gen.seed(genState);
+        mutationEngine.setSeed(engineState);
+        timeoutMs = static_cast<unsigned>(savedTimeout);
+        target.setTimeout(timeoutMs);
+        guided = savedGuided != 0;
+        campaign_stats::global().resumedExecs += execs;
+        worker_stats::bump(counters.execs, execs);
+        worker_stats::bump(counters.crashes, crashCount);
+        worker_stats::bump(counters.hangs, hangCount);
+        worker_stats::bump(counters.newCoverage, newCoverage);
+        crashes_detected += static_cast<int>(crashCount);
+        timeouts_detected += static_cast<int>(hangCount);
+        return true;
+    }
 public:
-    dumb_algorithm(std::string p, std::string q, int i, int m) : programPath(p), exampleQuery(q), iteration_count(i), current_mutation(m) {
+    // A seed of 0 picks a random one; it is logged so the run can be repeated.
+    // A timeout of 0 is calibrated from the sample. With resume set the campaign continues
+    // from the checkpoint in the work directory, if there is one. Without coverage feedback
+    // the power schedule is always EXPLORE, as there are no paths to count. The costliest
+    // inputs always go to the perf store; with an objective other than NONE, an input that
+    // makes it into the store's ranking for it also joins the queue, like new coverage.
+    dumb_algorithm(std::string p, std::string q, int i, int m, uint64_t s = 0, unsigned t = 0, bool r = false, power_schedule ps = power_schedule::FAST, sync_options so = sync_options(), unsigned ml = 0, perf_objective po = perf_objective::NONE) : programPath(p), exampleQuery(q), iteration_count(i), current_mutation(m), crashes(crashDirectory(q)), hangs(hangDirectory(q)), corpus(corpusDirectory(q)), seed(s), timeoutMs(t), resume(r), schedule(ps), syncing(std::move(so)), perf(perfDirectory(q)), memoryLimitMb(ml), objective(po) {
 
     };
-    void execute(std::regex regex) {
-        std::wstring wstrp(programPath.begin(), programPath.end());
-        wchar_t* wcharprogramPath = new wchar_t[wstrp.size() + 1];
-        std::wcscpy(wcharprogramPath, wstrp.c_str());
+    void execute(log_mask mask) {
+        if (!perf.load())
+            Logger::logError(mask, "Failed to create the perf directory: ", perfDirectory(exampleQuery));
+        if (!openCampaign(crashes, hangs, corpus, exampleQuery, seed, mask))
+            return;
+        wyrand gen(seed);
+
+        // The loop runs on this thread; it and the target stay on one core while it does.
+        pinned_thread pinned;
+        scratch_file input("cur");
+        if (!input.valid()) {
+            Logger::logError(mask, "Failed to create the input file for the target");
+            return;
+        }
+        coverage_map coverage;
+        jpgManager mutationEngine;
+        mutationEngine.setSeed(splitmix64(seed));
+        std::unique_ptr<executor> target = makeExecutor(programPath, input.path(), mask, coverage.valid() ? &coverage : nullptr, nullptr, memoryLimitMb);
+        queue.clear();
+        seed_scheduler scheduler(schedule);
+        for (uint32_t id = 0; id < corpus.size(); ++id) {
+            corpus_store::entry e = corpus.at(id);
+            queue.push_back({ id, false, jpeg_index() });
+            scheduler.add(e.execMicros, e.size, e.coverageHash);
+        }
 
-        STARTUPINFO si;
-        PROCESS_INFORMATION pi;
+        campaign_stats& stats = campaign_stats::global();
+        worker_stats& counters = stats.attach();
+        checkpoint state(workDirectory(exampleQuery));
+        bool guided = false;
+        int first = 0;
+        if (resume && resumeFrom(state, counters, *target, guided, first, scheduler, gen, mutationEngine)) {
+            guided = guided && coverage.valid();
+            Logger::logProcessInfo(mask, "Resumed from ", state.file(), " at iteration ", first, ", ", virgin.edgesSeen(), " edges");
+        }
+        else {
+            if (resume)
+                Logger::logError(mask, "No checkpoint to resume from in ", state.file(), ", starting over");
+            // Calibration runs the first input; its last run tells whether the target is
+            // instrumented and marks its edges as known.
+            timeoutMs = calibrateTimeout(*target, input, corpus.view(0), timeoutMs, mask);
+            if (!timeoutMs)
+                return;
+            guided = coverage.valid() && !coverage.empty();
+            if (guided) {
+                coverage.classify();
+                virgin.update(coverage);
+                Logger::logProcessInfo(mask, "Coverage feedback enabled, ", virgin.edgesSeen(), " edges in the sample");
+            }
+            else {
+                Logger::logProcessInfo(mask, "Target is not instrumented, coverage feedback is off");
+            }
+        }
+        stats.uniqueCrashes = crashes.size();
+        stats.uniqueHangs = hangs.size();
+        stats.corpusSize = corpus.size();
+        stats.edges = virgin.edgesSeen();
+        stats.slowestCpuMicros = perf.best(perf_objective::TIME);
+        stats.peakRssKb = perf.best(perf_objective::MEMORY);
+        if (!guided)
+            scheduler.setSchedule(power_schedule::EXPLORE);
+        Logger::logProcessInfo(mask, "Power schedule: ", scheduleName(scheduler.current()));
+        if (objective != perf_objective::NONE)
+            Logger::logProcessInfo(mask, "Perf objective: ", objectiveName(objective));
 
-        ZeroMemory(&si, sizeof(si));
-        si.cb = sizeof(si);
-        ZeroMemory(&pi, sizeof(pi));
+        dictionary tokens;
+        dictionary_harvester harvester(programPath, tokens, timeoutMs, mask);
+        for (uint32_t id = 0; id < corpus.size() && harvester.submit(corpus.view(id)); ++id)
+            ;
+        uint64_t tokensVersion = 0;
 
-        std::random_device rd;
-        std::mt19937 gen(rd());
-        std::uniform_int_distribution<> distr(15, 150);
+        std::unique_ptr<sync_client> sync;
+        if (syncing.enabled()) {
+            sync.reset(new sync_client(syncing.directory, syncing.name, syncing.primary, mask));
+            Logger::logProcessInfo(mask, "Syncing through ", syncing.directory, " as ", syncing.primary ? "primary " : "secondary ", syncing.name);
+        }
 
-        std::string exampleOutFile{};
-        {
-            fs::path examplepath(exampleQuery);
-            std::string outfilename{};
-            outfilename += std::to_string(++current_mutation);
-            outfilename += ".jpg";
-            fs::path eoutpath = examplepath.parent_path() / outfilename;
-            exampleOutFile += eoutpath.string();
-        }
-
-        jpgManager mutationEngine(exampleQuery, exampleOutFile, distr(gen));
-        mutationEngine.mutate(regex);
-
-        for (int i{}; i < iteration_count; ++i) {
-
-            std::string exampleOutFile2 = " ";
-            exampleOutFile2 += exampleOutFile;
-            exampleOutFile2 += " ";
-            std::wstring wstr(exampleOutFile2.begin(), exampleOutFile2.end());
-            wchar_t* wchararguments = new wchar_t[wstr.size() + 1];
-            std::wcscpy(wchararguments, wstr.c_str());
-
-            if (!CreateProcess(
-                wcharprogramPath,
-                const_cast<wchar_t*>(wchararguments),
-                NULL,
-                NULL,
-                FALSE,
-                CREATE_NO_WINDOW,
-                NULL,
-                NULL,
-                &si,
-                &pi
-            )) {
-                Logger::logError("CreateProcess failed " + GetLastError(), regex);
+        // Ranks a run in the perf store; true if it made the ranking of the objective.
+        auto rankCost = [&](const exec_result& result, const std::vector<unsigned char>& data) {
+            bool slower = perf.record(perf_objective::TIME, result.cpuMicros, data);
+            bool hungrier = perf.record(perf_objective::MEMORY, result.peakRssKb, data);
+            if (slower && result.cpuMicros > stats.slowestCpuMicros) {
+                stats.slowestCpuMicros = result.cpuMicros;
+                Logger::logProcessInfo(mask, "Slowest input so far: ", result.cpuMicros, " us of CPU time");
             }
-            else {
+            if (hungrier && result.peakRssKb > stats.peakRssKb) {
+                stats.peakRssKb = result.peakRssKb;
+                Logger::logProcessInfo(mask, "Hungriest input so far: ", result.peakRssKb, " KB peak memory");
+            }
+            return objective == perf_objective::TIME ? slower : objective == perf_objective::MEMORY && hungrier;
+        };
+
+        // Books one run of `data`, a mutant or an input from another instance. Only the
+        // primary passes on imported inputs, to the secondaries.
+        auto process = [&](const exec_result& result, long long micros, const std::vector<unsigned char>& data, uint32_t parentId, bool imported) {
+            counters.countExec(micros);
+            size_t bucketsBefore = crashes.size();
+            if (handleResult(result, crashes, hangs, data, mask)) {
                 crashes_detected++;
-                DWORD exitCode;
-                if (WaitForSingleObject(pi.hProcess, INFINITE) == WAIT_OBJECT_0) {
-                    if (!GetExitCodeProcess(pi.hProcess, &exitCode)) {
-                        Logger::logUnexpected("Failed to get exit code of the process. Saving file: " + std::to_string(current_mutation) + ".jpg", regex);
-                    }
-                    else if (exitCode == STATUS_ACCESS_VIOLATION) {
-                        Logger::logCrash("Process encountered an access violation. Saving file: " + std::to_string(current_mutation) + ".jpg", regex);
-                    }
-                    else {
-                        Logger::logProcessInfo("Process exited with code: " + exitCode, regex);
-                        crashes_detected--;
-                        const fs::path filePath(exampleOutFile);
-                        try {
-                            fs::remove(filePath);
-                        }
-                        catch (const fs::filesystem_error& ex) {
-                            Logger::logError("Failed to remove the file: " + exampleOutFile, regex);
-                        }
+                counters.countCrash();
+                stats.uniqueCrashes = crashes.size();
+                if (sync && !imported && crashes.size() > bucketsBefore)
+                    sync->publish(sync_client::CRASH, data);
+            }
+            else if (result.status == exec_status::TIMEOUT) {
+                timeouts_detected++;
+                counters.countHang();
+                stats.uniqueHangs = hangs.size();
+            }
+            else if (result.status == exec_status::OK) {
+                uint64_t path = 0;
+                bool newCoverage = false;
+                if (guided) {
+                    path = coverage.classify();
+                    scheduler.countPath(path);
+                    newCoverage = virgin.update(coverage) != virgin_map::NOTHING;
+                }
+                bool costly = rankCost(result, data);
+                if (newCoverage || costly) {
+                    bool isNew;
+                    uint32_t id = corpus.add(data, parentId, static_cast<uint32_t>(micros), path, &isNew);
+                    if (isNew) {
+                        queue.push_back({ id, true, jpeg_index::parse(data) });
+                        scheduler.add(static_cast<uint32_t>(micros), data.size(), path);
+                        harvester.submit(data);
+                        if (sync && (!imported || sync->isPrimary()))
+                            sync->publish(sync_client::INPUT, data);
                     }
+                    stats.corpusSize = corpus.size();
                 }
-                else {
-                    Logger::logUnexpected("Process crashed or terminated unexpectedly. Saving file: " + std::to_string(current_mutation) + ".jpg", regex);
+                if (newCoverage) {
+                    counters.countNewCoverage();
+                    stats.edges = virgin.edgesSeen();
+                    Logger::logProcessInfo(mask, "New coverage, queue size ", queue.size(), ", ", virgin.edgesSeen(), " edges");
                 }
-
-                std::cout << i + 1 << " / " << iteration_count << std::endl;
-                delete[] wchararguments;
-                CloseHandle(pi.hProcess);
-                CloseHandle(pi.hThread);
             }
-            {
-                exampleOutFile = "";
-                fs::path examplepath(exampleQuery);
-                std::string outfilename{};
-                outfilename += std::to_string(++current_mutation);
-                outfilename += ".jpg";
-                fs::path eoutpath = examplepath.parent_path() / outfilename;
-                exampleOutFile += eoutpath.string();
+        };
 
-                mutationEngine.setOut(exampleOutFile);
-                mutationEngine.setMC(distr(gen));
-                mutationEngine.mutate(regex);
+        campaign_control& control = campaign_control::global();
+        auto nextCheckpoint = std::chrono::steady_clock::now() + checkpoint::INTERVAL;
+        int i = first;
+        for (; i < iteration_count && control.proceed(); ++i) {
+            // Iteration i has not touched the RNG, the queue or the counters yet, so a
+            // resume from here runs it exactly once.
+            if (std::chrono::steady_clock::now() >= nextCheckpoint) {
+                saveCheckpoint(state, counters, guided, i, scheduler, gen, mutationEngine, mask);
+                nextCheckpoint = std::chrono::steady_clock::now() + checkpoint::INTERVAL;
+            }
+            if (sync && sync->hasImports()) {
+                for (const sync_client::item& imported : sync->collect()) {
+                    input.write(imported.bytes);
+                    auto start = std::chrono::steady_clock::now();
+                    exec_result result = target->run();
+                    process(result, std::chrono::duration_cast<std::chrono::microseconds>(std::chrono::steady_clock::now() - start).count(), imported.bytes, corpus_store::NO_PARENT, true);
+                }
+            }
+            if (tokens.version() != tokensVersion) {
+                tokensVersion = tokens.version();
+                mutationEngine.setDictionary(tokens.snapshot());
             }
+            mutationEngine.setMC(static_cast<int>(15 + gen.below(136)));
+            const queue_entry& parent = pick(scheduler.next(gen));
+            const queue_entry& donor = pick(gen.below(queue.size()));
+            input.write(mutationEngine.mutateFrom(corpus.view(parent.id), parent.index, corpus.view(donor.id), &donor.index));
+            uint32_t parentId = parent.id;
+            ++current_mutation;
+
+            auto start = std::chrono::steady_clock::now();
+            exec_result result = target->run();
+            process(result, std::chrono::duration_cast<std::chrono::microseconds>(std::chrono::steady_clock::now() - start).count(), mutationEngine.data(), parentId, false);
         }
+        saveCheckpoint(state, counters, guided, i, scheduler, gen, mutationEngine, mask);
+        unique_crashes_detected = static_cast<int>(crashes.size());
+        unique_hangs_detected = static_cast<int>(hangs.size());
     }
 };
 
 
-class dumb_algorithm_th : algorithm {
-    std::string programPath;
+// Runs every input on two or more targets, decoders of the same format, and keeps the
+// inputs they disagree on. Mutants are made BATCH at a time; each target runs the whole
+// batch on its own executor and pool worker, so the targets run side by side on separate
+// cores, and the results are compared once every target is through the batch. Only runs
+// that every target finished on its own are compared, on exit code and on output: stdout,
+// or the file named by FUZZER_OUTPUT with outputFiles. A divergence is bucketed in
+// <dir>/diffs by which targets agree with which and, if exit codes differ, by the codes.
+// Crashes and hangs of any target go to the usual buckets. The first target's coverage
+// guides the queue as in dumb_algorithm.
+class differential_algorithm : algorithm {
+    struct alignas(64) target_context {
+        std::string name;
+        std::string outputFile;
+        std::unique_ptr<scratch_file> input;
+        std::unique_ptr<coverage_map> coverage;
+        std::unique_ptr<executor> target;
+        worker_stats* stats = nullptr;
+        std::vector<exec_result> results;
+        std::vector<long long> micros;
+    };
+
+    std::vector<std::string> programs;
     std::string exampleQuery;
     int iteration_count;
-    int current_mutation;
-    void checkForCrash(wchar_t* wcharprogramPath, std::string exampleOutFile, jpgManager mutationEngine, STARTUPINFO si, PROCESS_INFORMATION pi, int a, int i, std::regex regex) {
-        std::string exampleOutFile2 = " ";
-        exampleOutFile2 += exampleOutFile;
-        exampleOutFile2 += " ";
-        std::wstring wstr(exampleOutFile2.begin(), exampleOutFile2.end());
-        wchar_t* wchararguments = new wchar_t[wstr.size() + 1];
-        std::wcscpy(wchararguments, wstr.c_str());
-
-        if (!CreateProcess(
-            wcharprogramPath,
-            const_cast<wchar_t*>(wchararguments),
-            NULL,
-            NULL,
-            FALSE,
-            0,
-            NULL,
-            NULL,
-            &si,
-            &pi
-        )) {
-            printf("[ERROR] CreateProcess failed (%d).\n", GetLastError());
+    crash_index crashes;
+    crash_index hangs;
+    crash_index divergences;
+    corpus_store corpus;
+    uint64_t seed;
+    unsigned timeoutMs;
+    bool outputFiles;
+    unsigned memoryLimitMb;
+    virgin_map virgin;
+    std::vector<std::unique_ptr<target_context>> contexts;
+    // Coverage of the first target for every input of the batch: the path hash and the
+    // classified trace. The virgin map only takes a trace once every target finished.
+    std::vector<uint64_t> paths;
+    std::vector<uint8_t> traces;
+
+    static constexpr int BATCH = 64;
+
+    // Runs the batch on target k; the first target also checks the coverage of every run.
+    void runBatch(size_t k, const std::vector<std::vector<unsigned char>>& batch) {
+        target_context& ctx = *contexts[k];
+        for (size_t i = 0; i < batch.size(); ++i) {
+            ctx.input->write(batch[i]);
+            auto start = std::chrono::steady_clock::now();
+            ctx.results[i] = ctx.target->run();
+            ctx.micros[i] = std::chrono::duration_cast<std::chrono::microseconds>(std::chrono::steady_clock::now() - start).count();
+            ctx.stats->countExec(static_cast<uint64_t>(ctx.micros[i]));
+            if (ctx.coverage && ctx.results[i].status == exec_status::OK) {
+                paths[i] = ctx.coverage->classify();
+                std::memcpy(&traces[i * MAP_SIZE], ctx.coverage->data(), MAP_SIZE);
+            }
         }
-        else {
-            crashes_detected++;
-            DWORD exitCode;
-            if (WaitForSingleObject(pi.hProcess, INFINITE) == WAIT_OBJECT_0) {
-                if (!GetExitCodeProcess(pi.hProcess, &exitCode)) {
-                    std::cerr << "[UNEXPECTED] Failed to get exit code of the process. Saving file: " << current_mutation << ".jpg\n";
-                }
-                else if (exitCode == STATUS_ACCESS_VIOLATION) {
-                    std::cout << "[CRASH] Process encountered an access violation. Saving file: " << current_mutation << ".jpg\n";
-                }
-                else {
-                    std::cout << "[PROCESS INFO] Process exited with code: " << exitCode << std::endl;
-                    crashes_detected--;
-                    const fs::path filePath(exampleOutFile);
-                    try {
-                        fs::remove(filePath);
-                    }
-                    catch (const fs::filesystem_error& ex) {
-                        std::cout << "[ERROR] Failed to remove the file: " << ex.what() << "\n";
-                    }
-                }
+    }
+    // Compares the runs of input i, all of which finished. Targets agree with the first
+    // target that has their exit code and output hash.
+    void compare(size_t i, const std::vector<unsigned char>& data, log_mask mask) {
+        bool exitCodes = false, outputs = false;
+        const exec_result& first = contexts[0]->results[i];
+        for (const auto& ctx : contexts) {
+            exitCodes |= ctx->results[i].exitCode != first.exitCode;
+            outputs |= ctx->results[i].outputHash != first.outputHash;
+        }
+        if (!exitCodes && !outputs)
+            return;
+        uint64_t key = splitmix64(exitCodes ? 2 : 1);
+        std::vector<std::string> groups;
+        std::vector<size_t> leaders;
+        for (size_t k = 0; k < contexts.size(); ++k) {
+            const exec_result& result = contexts[k]->results[i];
+            size_t group = 0;
+            while (group < leaders.size() && (contexts[leaders[group]]->results[i].exitCode != result.exitCode || contexts[leaders[group]]->results[i].outputHash != result.outputHash))
+                ++group;
+            if (group == leaders.size()) {
+                leaders.push_back(k);
+                groups.push_back(exitCodes ? "exit " + std::to_string(result.exitCode) + ": " : "");
             }
             else {
-                std::cerr << "[UNEXPECTED] Process crashed or terminated unexpectedly. Saving file: " << current_mutation << ".jpg\n";
+                groups[group] += ", ";
             }
-
-            std::cout << i + 1 << " / " << iteration_count << std::endl;
-            delete[] wchararguments;
-            CloseHandle(pi.hProcess);
-            CloseHandle(pi.hThread);
-        }
-        {
-            exampleOutFile = "";
-            fs::path examplepath(exampleQuery);
-            std::string outfilename{};
-            outfilename += std::to_string(++current_mutation);
-            outfilename += ".jpg";
-            fs::path eoutpath = examplepath.parent_path() / outfilename;
-            exampleOutFile += eoutpath.string();
-
-            mutationEngine.setOut(exampleOutFile);
-            mutationEngine.setMC(a);
-            mutationEngine.mutate(regex);
+            groups[group] += contexts[k]->name;
+            key = splitmix64(key ^ group);
+            if (exitCodes)
+                key = splitmix64(key ^ static_cast<uint32_t>(result.exitCode));
         }
+        std::string how = exitCodes ? "Targets disagree on the exit code (" : "Targets disagree on the output (";
+        for (size_t group = 0; group < groups.size(); ++group)
+            how += (group ? " | " : "") + groups[group];
+        how += ")";
+        crash_index::outcome bucket = divergences.record(key, data);
+        campaign_stats::global().uniqueDivergences = divergences.size();
+        if (bucket.isNew)
+            Logger::logCrash(mask, how, ". New divergence, saving file: ", bucket.file);
+        else
+            Logger::logCrash(mask, how, ". Divergence ", bucket.file, ", hit ", bucket.hits);
     }
 public:
-    dumb_algorithm_th(std::string p, std::string q, int i, int m) : programPath(p), exampleQuery(q), iteration_count(i), current_mutation(m) {};
-    void execute(std::regex regex) {
-        std::wstring wstrp(programPath.begin(), programPath.end());
-        wchar_t* wcharprogramPath = new wchar_t[wstrp.size() + 1];
-        std::wcscpy(wcharprogramPath, wstrp.c_str());
+    // programs holds the targets, at least two. With outputFiles the targets write their
+    // output to the file named by FUZZER_OUTPUT instead of stdout.
+    differential_algorithm(std::vector<std::string> p, std::string q, int i, uint64_t s = 0, unsigned t = 0, bool o = false, unsigned ml = 0) : programs(std::move(p)), exampleQuery(q), iteration_count(i), crashes(crashDirectory(q)), hangs(hangDirectory(q)), divergences(diffDirectory(q)), corpus(corpusDirectory(q)), seed(s), timeoutMs(t), outputFiles(o), memoryLimitMb(ml) {};
+    void execute(log_mask mask) {
+        if (programs.size() < 2) {
+            Logger::logError(mask, "Differential fuzzing needs at least two targets");
+            return;
+        }
+        if (!divergences.load())
+            Logger::logError(mask, "Failed to create the divergence directory: ", diffDirectory(exampleQuery));
+        if (!openCampaign(crashes, hangs, corpus, exampleQuery, seed, mask))
+            return;
+        wyrand gen(seed);
 
-        STARTUPINFO si;
-        PROCESS_INFORMATION pi;
+        // Target k belongs to worker k: it is set up and always runs on that worker's core.
+        campaign_stats& stats = campaign_stats::global();
+        worker_pool pool(static_cast<int>(programs.size()));
+        contexts.clear();
+        contexts.resize(programs.size());
+        std::atomic<bool> ready{ true };
+        pool.each([&](int k) {
+            std::unique_ptr<target_context> ctx(new target_context);
+            ctx->name = fs::path(programs[k]).filename().string();
+            ctx->input.reset(new scratch_file("diff" + std::to_string(k)));
+            if (!ctx->input->valid()) {
+                ready = false;
+                return;
+            }
+            if (k == 0) {
+                ctx->coverage.reset(new coverage_map);
+                if (!ctx->coverage->valid())
+                    ctx->coverage.reset();
+            }
+            if (outputFiles)
+                ctx->outputFile = "/dev/shm/fuzzer-" + std::to_string(getpid()) + "-out" + std::to_string(k);
+            ctx->target = makeExecutor(programs[k], ctx->input->path(), mask, ctx->coverage.get(), nullptr, memoryLimitMb, true, ctx->outputFile);
+            ctx->stats = &stats.attach();
+            ctx->results.resize(BATCH);
+            ctx->micros.resize(BATCH);
+            contexts[k] = std::move(ctx);
+            });
+        if (!ready) {
+            Logger::logError(mask, "Failed to create the input file for the target");
+            return;
+        }
+        // Every target gets the timeout of the slowest, times the number of targets that
+        // share a core while they run side by side.
+        unsigned timeout = 0;
+        for (auto& ctx : contexts) {
+            unsigned calibrated = calibrateTimeout(*ctx->target, *ctx->input, corpus.view(0), timeoutMs, mask);
+            if (!calibrated)
+                return;
+            timeout = std::max(timeout, calibrated);
+        }
+        unsigned cores = std::max(1u, std::thread::hardware_concurrency());
+        if (!timeoutMs)
+            timeout *= static_cast<unsigned>((contexts.size() + cores - 1) / cores);
+        for (auto& ctx : contexts)
+            ctx->target->setTimeout(timeout);
+        bool guided = contexts[0]->coverage && !contexts[0]->coverage->empty();
+        if (guided) {
+            contexts[0]->coverage->classify();
+            virgin.update(*contexts[0]->coverage);
+        }
+        if (contexts[0]->coverage)
+            traces.assign(BATCH * MAP_SIZE, 0);
+        Logger::logProcessInfo(mask, "Comparing ", contexts.size(), " targets, coverage feedback ", guided ? "on" : "off");
 
-        ZeroMemory(&si, sizeof(si));
-        si.cb = sizeof(si);
-        ZeroMemory(&pi, sizeof(pi));
+        jpgManager mutationEngine;
+        mutationEngine.setSeed(splitmix64(seed));
+        seed_scheduler scheduler(guided ? power_schedule::FAST : power_schedule::EXPLORE);
+        std::vector<jpeg_index> indexes;
+        for (uint32_t id = 0; id < corpus.size(); ++id) {
+            corpus_store::entry e = corpus.at(id);
+            indexes.push_back(jpeg_index::parse(corpus.view(id)));
+            scheduler.add(e.execMicros, e.size, e.coverageHash);
+        }
+        stats.uniqueCrashes = crashes.size();
+        stats.uniqueHangs = hangs.size();
+        stats.uniqueDivergences = divergences.size();
+        stats.corpusSize = corpus.size();
+        stats.edges = virgin.edgesSeen();
 
-        std::random_device rd;
-        std::mt19937 gen(rd());
-        std::uniform_int_distribution<> distr(15, 150);
+        campaign_control& control = campaign_control::global();
+        std::vector<std::vector<unsigned char>> batch;
+        std::vector<uint32_t> parents;
+        for (int i = 0; i < iteration_count && control.proceed(); i += BATCH) {
+            batch.clear();
+            parents.clear();
+            for (int j = 0; j < BATCH && i + j < iteration_count; ++j) {
+                mutationEngine.setMC(static_cast<int>(15 + gen.below(136)));
+                uint32_t parent = static_cast<uint32_t>(scheduler.next(gen));
+                uint32_t donor = static_cast<uint32_t>(gen.below(corpus.size()));
+                batch.push_back(mutationEngine.mutateFrom(corpus.view(parent), indexes[parent], corpus.view(donor), &indexes[donor]));
+                parents.push_back(parent);
+            }
+            paths.assign(batch.size(), 0);
+            pool.each([&](int k) {
+                runBatch(static_cast<size_t>(k), batch);
+                });
 
-        std::string exampleOutFile{};
-        {
-            fs::path examplepath(exampleQuery);
-            std::string outfilename{};
-            outfilename += std::to_string(++current_mutation);
-            outfilename += ".jpg";
-            fs::path eoutpath = examplepath.parent_path() / outfilename;
-            exampleOutFile += eoutpath.string();
+            for (size_t j = 0; j < batch.size(); ++j) {
+                bool finished = true;
+                for (auto& ctx : contexts) {
+                    const exec_result& result = ctx->results[j];
+                    if (handleResult(result, crashes, hangs, batch[j], mask)) {
+                        crashes_detected++;
+                        ctx->stats->countCrash();
+                        stats.uniqueCrashes = crashes.size();
+                    }
+                    else if (result.status == exec_status::TIMEOUT) {
+                        timeouts_detected++;
+                        ctx->stats->countHang();
+                        stats.uniqueHangs = hangs.size();
+                    }
+                    finished &= result.status == exec_status::OK;
+                }
+                if (!finished)
+                    continue;
+                compare(j, batch[j], mask);
+                if (guided) {
+                    scheduler.countPath(paths[j]);
+                    if (virgin.update(&traces[j * MAP_SIZE]) != virgin_map::NOTHING) {
+                        bool isNew;
+                        uint32_t micros = static_cast<uint32_t>(contexts[0]->micros[j]);
+                        uint32_t id = corpus.add(batch[j], parents[j], micros, paths[j], &isNew);
+                        if (isNew) {
+                            indexes.push_back(jpeg_index::parse(batch[j]));
+                            scheduler.add(micros, batch[j].size(), paths[j]);
+                        }
+                        contexts[0]->stats->countNewCoverage();
+                        stats.corpusSize = corpus.size();
+                        stats.edges = virgin.edgesSeen();
+                        Logger::logProcessInfo(mask, "New coverage in ", id, ", ", virgin.edgesSeen(), " edges");
+                    }
+                }
+            }
         }
+        corpus.sync();
+        crashes.save();
+        hangs.save();
+        divergences.save();
+        for (auto& ctx : contexts)
+            if (!ctx->outputFile.empty())
+                unlink(ctx->outputFile.c_str());
+        unique_crashes_detected = static_cast<int>(crashes.size());
+        unique_hangs_detected = static_cast<int>(hangs.size());
+    }
+};
+
+// DUMB on several workers, for campaigns started with more than one (-j). Every worker
+// mutates random corpus entries on its own executor; chunks of iterations are handed out by
+// the worker pool. There is no coverage feedback, checkpoint or sync; those need the single
+// queue of dumb_algorithm.
+class dumb_algorithm_th : algorithm {
+    std::string programPath;
+    std::string exampleQuery;
+    int iteration_count;
+    int current_mutation;
+    int numThreads;
+    uint64_t seed;
+    unsigned timeoutMs;
+    unsigned memoryLimitMb;
+    crash_index crashes;
+    crash_index hangs;
+    corpus_store corpus;
+    // Segment index of every corpus entry, parsed once; the corpus does not grow here.
+    std::vector<jpeg_index> indexes;
 
-        jpgManager mutationEngine(exampleQuery, exampleOutFile, distr(gen));
-        mutationEngine.mutate(regex);
+    void checkForCrash(worker_context& ctx, log_mask mask) {
+        if (!campaign_control::global().proceed())
+            return;
+        ctx.mutationEngine.setMC(static_cast<int>(15 + ctx.rng.below(136)));
+        uint32_t parent = static_cast<uint32_t>(ctx.rng.below(corpus.size()));
+        ctx.input->write(ctx.mutationEngine.mutateFrom(corpus.view(parent), indexes[parent]));
 
-        int numThreads = 4;
-        std::vector<std::thread> threads;
-        for (int i{}; i < iteration_count / numThreads; ++i) {
-            for (int j = 0; j < numThreads; ++j) {
-                int a = distr(gen);
-                int b = i * numThreads + j;
-                threads.emplace_back([&, wcharprogramPath, exampleOutFile, mutationEngine, si, pi, a, b]() {
-                    checkForCrash(wcharprogramPath, exampleOutFile, mutationEngine, si, pi, a, b, regex);
-                    });
-            }
+        auto start = std::chrono::steady_clock::now();
+        exec_result result = ctx.target->run();
+        ctx.stats->countExec(std::chrono::duration_cast<std::chrono::microseconds>(std::chrono::steady_clock::now() - start).count());
+        if (handleResult(result, crashes, hangs, ctx.mutationEngine.data(), mask)) {
+            ctx.stats->countCrash();
+            campaign_stats::global().uniqueCrashes = crashes.size();
         }
-        for (std::thread& thread : threads) {
-            thread.join();
+        else if (result.status == exec_status::TIMEOUT) {
+            ctx.stats->countHang();
+            campaign_stats::global().uniqueHangs = hangs.size();
+        }
+    }
+public:
+    static constexpr int CHUNK_SIZE = 32;
+
+    dumb_algorithm_th(std::string p, std::string q, int i, int m, int t = 0, uint64_t s = 0, unsigned timeout = 0, unsigned ml = 0) : programPath(p), exampleQuery(q), iteration_count(i), current_mutation(m), numThreads(t), seed(s), timeoutMs(timeout), memoryLimitMb(ml), crashes(crashDirectory(q)), hangs(hangDirectory(q)), corpus(corpusDirectory(q)) {};
+    void execute(log_mask mask) {
+        if (!openCampaign(crashes, hangs, corpus, exampleQuery, seed, mask))
+            return;
+        worker_pool pool(numThreads);
+        std::vector<std::unique_ptr<worker_context>> contexts = makeContexts(pool, "cur", programPath, false, memoryLimitMb, seed, mask);
+        if (contexts.empty())
+            return;
+        unsigned timeout = calibrateTimeout(*contexts[0]->target, *contexts[0]->input, corpus.view(0), timeoutMs, mask);
+        if (!timeout)
+            return;
+        for (const auto& ctx : contexts)
+            ctx->target->setTimeout(timeout);
+
+        campaign_stats& stats = campaign_stats::global();
+        stats.uniqueCrashes = crashes.size();
+        stats.uniqueHangs = hangs.size();
+        stats.corpusSize = corpus.size();
+        indexes.assign(corpus.size(), jpeg_index());
+        pool.run(static_cast<int>(corpus.size()), CHUNK_SIZE, [&](int, int id) {
+            indexes[id] = jpeg_index::parse(corpus.view(static_cast<uint32_t>(id)));
+            });
+        pool.run(iteration_count, CHUNK_SIZE, [&](int worker, int) {
+            checkForCrash(*contexts[worker], mask);
+            });
+
+        // A stopped campaign skips the rest of its iterations; only the ones that ran count.
+        for (const auto& ctx : contexts) {
+            crashes_detected += static_cast<int>(ctx->stats->crashes.load());
+            timeouts_detected += static_cast<int>(ctx->stats->hangs.load());
+            current_mutation += static_cast<int>(ctx->stats->execs.load());
         }
+        crashes.save();
+        hangs.save();
+        unique_crashes_detected = static_cast<int>(crashes.size());
+        unique_hangs_detected = static_cast<int>(hangs.size());
     }
 };
 
 
+// Keeps the whole population in memory and evaluates it in parallel on the worker pool.
+// Fitness rewards new coverage, the number of edges reached and exec time; individuals
+// with new coverage go into the corpus, crashing ones are saved and do not breed.
 class genetic_algorithm : algorithm {
 private:
+    struct individual {
+        std::vector<unsigned char> genes;
+        jpeg_index index;
+        double fitness = 0;
+        bool crashed = false;
+    };
+
     std::string programPath;
     std::string exampleQuery;
-    int crashnum;
+    crash_index crashes;
+    crash_index hangs;
+    corpus_store corpus;
+    int numThreads;
+    uint64_t seed;
+    unsigned timeoutMs;
+    bool resume;
+    unsigned memoryLimitMb;
+    virgin_map virgin;
+    std::mutex virginMutex;
+    dictionary_harvester* harvester = nullptr;
+
+    void evaluate(worker_context& ctx, individual& member, log_mask mask) {
+        ctx.input->write(member.genes);
+        auto start = std::chrono::steady_clock::now();
+        exec_result result = ctx.target->run();
+        double micros = std::chrono::duration<double, std::micro>(std::chrono::steady_clock::now() - start).count();
+        ctx.stats->countExec(static_cast<uint64_t>(micros));
 
-    bool hasCrashed(const std::string& inputFile) {
-        std::cout << crashnum + 1 << std::endl;
-        std::wstring wstrp(programPath.begin(), programPath.end());
-        wchar_t* wcharprogramPath = new wchar_t[wstrp.size() + 1];
-        std::wcscpy(wcharprogramPath, wstrp.c_str());
+        member.crashed = false;
+        member.fitness = 0;
+        if (handleResult(result, crashes, hangs, member.genes, mask)) {
+            member.crashed = true;
+            ctx.stats->countCrash();
+            campaign_stats::global().uniqueCrashes = crashes.size();
+            return;
+        }
+        if (result.status == exec_status::TIMEOUT) {
+            ctx.stats->countHang();
+            campaign_stats::global().uniqueHangs = hangs.size();
+        }
+        if (result.status != exec_status::OK)
+            return;
 
-        std::string exampleOutFile2 = " ";
-        exampleOutFile2 += inputFile;
-        exampleOutFile2 += " ";
-        std::wstring wstr(exampleOutFile2.begin(), exampleOutFile2.end());
-        wchar_t* wchararguments = new wchar_t[wstr.size() + 1];
-        std::wcscpy(wchararguments, wstr.c_str());
+        member.fitness = micros / 100.0;
+        if (ctx.coverage) {
+            uint64_t path = ctx.coverage->classify();
+            member.fitness += static_cast<double>(ctx.coverage->edgesHit());
+            virgin_map::novelty found;
+            size_t edges;
+            {
+                std::lock_guard<std::mutex> lock(virginMutex);
+                found = virgin.update(*ctx.coverage);
+                edges = virgin.edgesSeen();
+            }
+            if (found != virgin_map::NOTHING) {
+                bool isNew;
+                corpus.add(member.genes, corpus_store::NO_PARENT, static_cast<uint32_t>(micros), path, &isNew);
+                if (isNew && harvester)
+                    harvester->submit(member.genes);
+                ctx.stats->countNewCoverage();
+                campaign_stats::global().corpusSize = corpus.size();
+                campaign_stats::global().edges = edges;
+            }
+            if (found == virgin_map::NEW_EDGES)
+                member.fitness += 100;
+            else if (found == virgin_map::NEW_COUNTS)
+                member.fitness += 10;
+        }
+    }
+    const individual& tournament(const std::vector<individual>& population, wyrand& rng) {
+        const individual* best = &population[rng.below(population.size())];
+        for (int k = 1; k < TOURNAMENT_SIZE; ++k) {
+            const individual& other = population[rng.below(population.size())];
+            if (!other.crashed && (best->crashed || other.fitness > best->fitness))
+                best = &other;
+        }
+        return *best;
+    }
+    // Single-point crossover for inputs that are not JPEGs; keeps the first HEADER_SIZE bytes of the first parent.
+    std::vector<unsigned char> crossover(const std::vector<unsigned char>& first, const std::vector<unsigned char>& second, wyrand& rng) {
+        if (first.size() <= HEADER_SIZE || second.size() <= HEADER_SIZE)
+            return first;
+        size_t point = HEADER_SIZE + rng.below(std::min(first.size(), second.size()) - HEADER_SIZE);
+        std::vector<unsigned char> child(first.begin(), first.begin() + point);
+        child.insert(child.end(), second.begin() + point, second.end());
+        return child;
+    }
+    // Records the population about to be evaluated.
+    void saveCheckpoint(checkpoint& state, const std::vector<std::unique_ptr<worker_context>>& contexts, int generation, const wyrand& rng, const jpgManager& mutationEngine, const std::vector<individual>& population, log_mask mask) {
+        flushCampaign(corpus, crashes, hangs);
+        uint64_t execs = 0, crashCount = 0, hangCount = 0, newCoverage = 0;
+        for (const auto& ctx : contexts) {
+            execs += ctx->stats->execs.load();
+            crashCount += ctx->stats->crashes.load();
+            hangCount += ctx->stats->hangs.load();
+            newCoverage += ctx->stats->newCoverage.load();
+        }
+        state.begin("GENETIC");
+        state.put(static_cast<uint64_t>(generation));
+        state.put(rng.state());
+        state.put(mutationEngine.rngState());
+        state.put(timeoutMs);
+        state.put(execs);
+        state.put(crashCount);
+        state.put(hangCount);
+        state.put(newCoverage);
+        state.put(virgin.raw());
+        state.put(population.size());
+        for (const auto& member : population)
+            state.put(member.genes);
+        if (!state.commit())
+            Logger::logError(mask, "Failed to write the checkpoint ", state.file());
+    }
+    // The saved counters go to the first worker; they are only ever summed up.
+    bool resumeFrom(checkpoint& state, worker_stats& counters, int& generation, wyrand& rng, jpgManager& mutationEngine, std::vector<individual>& population) {
+        if (!state.load("GENETIC"))
+            return false;
+        uint64_t savedGeneration = state.get(), rngState = state.get(), engineState = state.get(), savedTimeout = state.get();
+        uint64_t execs = state.get(), crashCount = state.get(), hangCount = state.get(), newCoverage = state.get();
+        std::vector<unsigned char> bits = state.getBytes();
+        uint64_t count = state.get();
+        if (count > POPULATION_SIZE)
+            return false;
+        std::vector<individual> saved(count);
+        for (auto& member : saved) {
+            member.genes = state.getBytes();
+            member.index = jpeg_index::parse(member.genes);
+        }
+        if (!state.good() || saved.empty() || !savedTimeout || !virgin.restore(bits))
+            return false;
+        generation = static_cast<int>(savedGeneration);
+        rng.seed(rngState);
+        mutationEngine.setSeed(engineState);
+        timeoutMs = static_cast<unsigned>(savedTimeout);
+        population = std::move(saved);
+        campaign_stats::global().resumedExecs += execs;
+        worker_stats::bump(counters.execs, execs);
+        worker_stats::bump(counters.crashes, crashCount);
+        worker_stats::bump(counters.hangs, hangCount);
+        worker_stats::bump(counters.newCoverage, newCoverage);
+        return true;
+    }
+public:
+    static constexpr int POPULATION_SIZE = 10;
+    static constexpr int MAX_GENERATIONS = 100;
+    static constexpr double MUTATION_RATE = 0.1;
+    static constexpr double CROSSOVER_RATE = 0.8;
+    static constexpr int TOURNAMENT_SIZE = 3;
+    static constexpr size_t HEADER_SIZE = 16;
 
-        STARTUPINFO si;
-        PROCESS_INFORMATION pi;
+    genetic_algorithm(const std::string& i, const std::string& q, int t = 0, uint64_t s = 0, unsigned timeout = 0, bool r = false, unsigned ml = 0) : programPath(i), exampleQuery(q), crashes(crashDirectory(q)), hangs(hangDirectory(q)), corpus(corpusDirectory(q)), numThreads(t), seed(s), timeoutMs(timeout), resume(r), memoryLimitMb(ml) {};
+    void execute(log_mask mask) {
+        if (!openCampaign(crashes, hangs, corpus, exampleQuery, seed, mask))
+            return;
+        worker_pool pool(numThreads);
+        wyrand rng(seed);
+        std::uniform_real_distribution<double> chance(0.0, 1.0);
 
-        ZeroMemory(&si, sizeof(si));
-        si.cb = sizeof(si);
-        ZeroMemory(&pi, sizeof(pi));
+        std::vector<std::unique_ptr<worker_context>> contexts = makeContexts(pool, "ga", programPath, true, memoryLimitMb, seed, mask);
+        if (contexts.empty())
+            return;
+        jpgManager mutationEngine;
+        std::vector<individual> population;
+        checkpoint state(workDirectory(exampleQuery));
+        int generation = 0;
+        if (resume && resumeFrom(state, *contexts[0]->stats, generation, rng, mutationEngine, population)) {
+            Logger::logProcessInfo(mask, "Resumed from ", state.file(), " at generation ", generation + 1, ", ", virgin.edgesSeen(), " edges");
+        }
+        else {
+            if (resume)
+                Logger::logError(mask, "No checkpoint to resume from in ", state.file(), ", starting over");
+            timeoutMs = calibrateTimeout(*contexts[0]->target, *contexts[0]->input, corpus.view(0), timeoutMs, mask);
+            if (!timeoutMs)
+                return;
 
-        std::string exampleOutFile{};
-        {
-            fs::path examplepath(inputFile);
-            std::string outfilename{};
-            outfilename += std::to_string(++crashnum);
-            outfilename += ".jpg";
-            fs::path eoutpath = examplepath.parent_path() / outfilename;
-            exampleOutFile += eoutpath.string();
-        }
-        std::random_device rd;
-        std::mt19937 gen(rd());
-        std::uniform_int_distribution<> distr(15, 150);
-
-        /*jpgManager mutationEngine(inputFile, exampleOutFile, distr(gen));
-        mutationEngine.mutate();*/
-
-        if (!CreateProcess(
-            wcharprogramPath,
-            const_cast<wchar_t*>(wchararguments),
-            NULL,
-            NULL,
-            FALSE,
-            0,
-            NULL,
-            NULL,
-            &si,
-            &pi
-        )) {
-            printf("CreateProcess failed (%d).\n", GetLastError());
-            return 0;
+            // The first generation is bred from random corpus entries.
+            mutationEngine.setSeed(splitmix64(seed));
+            mutationEngine.setMC(30);
+            population.resize(POPULATION_SIZE);
+            for (auto& member : population) {
+                byte_view parent = corpus.view(static_cast<uint32_t>(rng.below(corpus.size())));
+                member.genes = mutationEngine.mutateFrom(parent, jpeg_index::parse(parent));
+                member.index = jpeg_index::parse(member.genes);
+            }
         }
-        crashes_detected++;
-        DWORD exitCode;
-        if (WaitForSingleObject(pi.hProcess, INFINITE) == WAIT_OBJECT_0) {
-            if (!GetExitCodeProcess(pi.hProcess, &exitCode)) {
-                std::cerr << "Failed to get exit code of child process." << std::endl;
-                return 1;
+        for (const auto& ctx : contexts)
+            ctx->target->setTimeout(timeoutMs);
+        mutationEngine.setMC(15);
+        campaign_stats& stats = campaign_stats::global();
+        stats.uniqueCrashes = crashes.size();
+        stats.uniqueHangs = hangs.size();
+        stats.corpusSize = corpus.size();
+
+        dictionary tokens;
+        dictionary_harvester tokenHarvester(programPath, tokens, timeoutMs, mask);
+        for (uint32_t id = 0; id < corpus.size() && tokenHarvester.submit(corpus.view(id)); ++id)
+            ;
+        harvester = &tokenHarvester;
+
+        campaign_control& control = campaign_control::global();
+        auto nextCheckpoint = std::chrono::steady_clock::now() + checkpoint::INTERVAL;
+        for (; generation < MAX_GENERATIONS && control.proceed(); ++generation) {
+            mutationEngine.setDictionary(tokens.snapshot());
+            // Workers are idle between generations, so the checkpoint does not hold them up.
+            if (std::chrono::steady_clock::now() >= nextCheckpoint) {
+                saveCheckpoint(state, contexts, generation, rng, mutationEngine, population, mask);
+                nextCheckpoint = std::chrono::steady_clock::now() + checkpoint::INTERVAL;
             }
-            else if (exitCode == STATUS_ACCESS_VIOLATION) {
-                std::cout << "Child process encountered an access violation." << std::endl;
-                return 1;
+            pool.run(static_cast<int>(population.size()), 1, [&](int worker, int i) {
+                evaluate(*contexts[worker], population[i], mask);
+                });
+
+            const individual* best = nullptr;
+            for (const auto& member : population)
+                if (!member.crashed && (!best || member.fitness > best->fitness))
+                    best = &member;
+            if (!best) {
+                Logger::logUnexpected(mask, "Every individual of generation ", generation + 1, " crashed the target");
+                break;
             }
-            else {
-                std::cout << "Child process exited with code: " << exitCode << std::endl;
-                crashes_detected--;
-                const fs::path filePath(exampleOutFile);
-                try {
-                    fs::remove(filePath);
+
+            // The best individual survives unchanged, the rest are bred from tournaments.
+            std::vector<individual> nextGeneration(1);
+            nextGeneration[0].genes = best->genes;
+            nextGeneration[0].index = best->index;
+            while (nextGeneration.size() < population.size()) {
+                individual child;
+                const individual& first = tournament(population, rng);
+                if (chance(rng) < CROSSOVER_RATE) {
+                    const individual& second = tournament(population, rng);
+                    if (first.index.valid && second.index.valid)
+                        child.genes = mutationEngine.crossover(first.genes, first.index, second.genes, second.index);
+                    else
+                        child.genes = crossover(first.genes, second.genes, rng);
                 }
-                catch (const fs::filesystem_error& ex) {
-                    std::cout << "[ERROR] Failed to remove the file: " << ex.what() << "\n";
+                else {
+                    child.genes = first.genes;
                 }
-                return 0;
-            }
-        }
-        else {
-            std::cerr << "Child process crashed or terminated unexpectedly." << std::endl;
-            return 1;
-        }
-    }
-    void crossover(const std::string& file1Path, const std::string& file2Path, const std::string& outputPath) {
-        std::ifstream file1(file1Path, std::ios::binary);
-        std::ifstream file2(file2Path, std::ios::binary);
-        std::ofstream output(outputPath, std::ios::binary);
-
-        if (!file1 || !file2 || !output) {
-            //std::cerr << "Error opening files." << std::endl;
-            return;
-        }
-        const int headerSize = 16;
-        std::vector<char> headerBuffer(headerSize);
-        file1.read(headerBuffer.data(), headerSize);
-        output.write(headerBuffer.data(), headerSize);
-
-        std::vector<char> file1Data((std::istreambuf_iterator<char>(file1)), std::istreambuf_iterator<char>());
-        std::vector<char> file2Data((std::istreambuf_iterator<char>(file2)), std::istreambuf_iterator<char>());
-        const int crossoverPoint = std::rand() % (file1Data.size() - headerSize) + headerSize;
-        output.write(file1Data.data() + headerSize, crossoverPoint - headerSize);
-        output.write(file2Data.data() + crossoverPoint, file2Data.size() - crossoverPoint);
-
-        file1.close();
-        file2.close();
-        output.close();
-    }
-public:
-    genetic_algorithm(const std::string& i, const std::string& q, int n) : programPath(i), exampleQuery(q), crashnum(n) {};
-    void execute(std::regex regex) {
-        const int POPULATION_SIZE = 10;
-        const int MAX_GENERATIONS = 100;
-        const double MUTATION_RATE = 0.1;
-        const double CROSSOVER_RATE = 0.8;
-
-        std::srand(static_cast<unsigned int>(std::time(nullptr)));
-
-        std::vector<std::string> population(POPULATION_SIZE);
-        for (auto& inputFile : population) {
-            int n = 10;
-            fs::path examplepath(exampleQuery);
-            std::string outfilename{};
-            outfilename += std::to_string(n);
-            outfilename += ".jpg";
-            fs::path eoutpath = examplepath.parent_path() / outfilename;
-            inputFile += eoutpath.string();
-            jpgManager mutationEngine(exampleQuery, inputFile, 30);
-            mutationEngine.mutate(regex);
-        }
-
-        int generation{};
-        while (generation < MAX_GENERATIONS) {
-            std::vector<std::string> nextGeneration;
-            std::vector<bool> crashedPopulation(POPULATION_SIZE, false);
-            for (int i = 0; i < POPULATION_SIZE; ++i) {
-                if (hasCrashed(population[i])) {
-                    std::string a;
-                    std::cin >> a;
-                    crashedPopulation[i] = true;
+                child.index = jpeg_index::parse(child.genes);
+                if (chance(rng) < MUTATION_RATE) {
+                    child.genes = mutationEngine.mutateFrom(child.genes, child.index);
+                    child.index = jpeg_index::parse(child.genes);
                 }
+                nextGeneration.push_back(std::move(child));
             }
-            for (int i = 0; i < POPULATION_SIZE; ++i) {
-                if (crashedPopulation[i]) {
-                    continue;
-                }
-                for (int j = i + 1; j < POPULATION_SIZE; ++j) {
-                    if (crashedPopulation[j]) {
-                        continue;
-                    }
-                    if (static_cast<float>(std::rand()) / RAND_MAX < CROSSOVER_RATE) {
-                        std::string offspring;
-                        crossover(population[i], population[j], offspring);
-                        nextGeneration.push_back(offspring);
-                    }
+            population = std::move(nextGeneration);
+        }
+
+        for (const auto& ctx : contexts) {
+            crashes_detected += static_cast<int>(ctx->stats->crashes.load());
+            timeouts_detected += static_cast<int>(ctx->stats->hangs.load());
+        }
+        saveCheckpoint(state, contexts, generation, rng, mutationEngine, population, mask);
+        harvester = nullptr;
+        unique_crashes_detected = static_cast<int>(crashes.size());
+        unique_hangs_detected = static_cast<int>(hangs.size());
+    }
+};
+
+// Shrinks a crashing input as long as it keeps crashing in the same bucket: whole JPEG
+// segments are dropped first, then ddmin-style chunk removal runs inside the segment bodies
+// with their length fields fixed up, and finally the remaining bytes are normalized to '0'.
+// All units of one granularity are tried at once on the worker pool; the ones that keep
+// the crash on their own are then applied together, bisecting the set if that loses it.
+class crash_minimizer : algorithm {
+private:
+    enum reduction { REMOVE, NORMALIZE };
+
+    // Bytes [begin, end) of the current input; owner is the offset of the segment whose
+    // length field covers them, or SIZE_MAX when there is none to fix up.
+    struct unit {
+        size_t begin;
+        size_t end;
+        size_t owner;
+    };
+
+    std::string programPath;
+    std::string crashFile;
+    int numThreads;
+    unsigned timeoutMs;
+    unsigned memoryLimitMb;
+    uint64_t bucket;
+    std::vector<std::unique_ptr<worker_context>> contexts;
+
+    // Once the campaign is stopped nothing reproduces, so minimization ends with the smallest input so far.
+    bool reproduces(worker_context& ctx, const std::vector<unsigned char>& candidate) {
+        if (!campaign_control::global().proceed())
+            return false;
+        ctx.input->write(candidate);
+        auto start = std::chrono::steady_clock::now();
+        exec_result result = ctx.target->run();
+        ctx.stats->countExec(std::chrono::duration_cast<std::chrono::microseconds>(std::chrono::steady_clock::now() - start).count());
+        ++ctx.execs;
+        return (result.status == exec_status::CRASH || result.status == exec_status::UNEXPECTED) && crash_index::keyOf(result) == bucket;
+    }
+    // Segment bodies of a JPEG split into chunks, or the whole input for anything else.
+    static std::vector<unit> chunksOf(const std::vector<unsigned char>& current, size_t chunkSize) {
+        std::vector<unit> units;
+        jpeg_index index = jpeg_index::parse(current);
+        if (!index.valid) {
+            for (size_t begin = 0; begin < current.size(); begin += chunkSize)
+                units.push_back({ begin, std::min(current.size(), begin + chunkSize), SIZE_MAX });
+            return units;
+        }
+        for (const jpeg_segment& segment : index.segments) {
+            size_t owner = segment.hasLength() ? segment.offset : SIZE_MAX;
+            size_t end = segment.bodyOffset() + segment.bodySize();
+            for (size_t begin = segment.bodyOffset(); begin < end; begin += chunkSize)
+                units.push_back({ begin, std::min(end, begin + chunkSize), owner });
+        }
+        return units;
+    }
+    static std::vector<unit> segmentsOf(const std::vector<unsigned char>& current) {
+        std::vector<unit> units;
+        jpeg_index index = jpeg_index::parse(current);
+        if (index.valid)
+            for (size_t k = 1; k < index.segments.size(); ++k)
+                units.push_back({ index.segments[k].offset, index.segments[k].offset + index.segments[k].size, SIZE_MAX });
+        return units;
+    }
+    // Copy of current with the picked units (ascending) removed or normalized.
+    static std::vector<unsigned char> apply(const std::vector<unsigned char>& current, const std::vector<unit>& units, const std::vector<size_t>& picked, reduction how) {
+        std::vector<unsigned char> candidate;
+        candidate.reserve(current.size());
+        size_t from = 0;
+        for (size_t k : picked) {
+            const unit& u = units[k];
+            candidate.insert(candidate.end(), current.begin() + from, current.begin() + u.begin);
+            if (how == NORMALIZE)
+                candidate.insert(candidate.end(), u.end - u.begin, '0');
+            from = u.end;
+        }
+        candidate.insert(candidate.end(), current.begin() + from, current.end());
+        if (how == REMOVE) {
+            // Owners come before their units, so their offsets are the same in the candidate.
+            size_t removedBefore = 0;
+            for (size_t k = 0; k < picked.size(); ) {
+                size_t owner = units[picked[k]].owner;
+                size_t removed = 0;
+                size_t next = k;
+                for (; next < picked.size() && units[picked[next]].owner == owner; ++next)
+                    removed += units[picked[next]].end - units[picked[next]].begin;
+                if (owner != SIZE_MAX) {
+                    size_t at = owner - removedBefore;
+                    size_t length = (static_cast<size_t>(candidate[at + 2]) << 8 | candidate[at + 3]) - removed;
+                    candidate[at + 2] = static_cast<unsigned char>(length >> 8);
+                    candidate[at + 3] = static_cast<unsigned char>(length);
                 }
+                removedBefore += removed;
+                k = next;
             }
-            for (auto& individual : nextGeneration) {
-                if (static_cast<double>(std::rand()) / RAND_MAX < MUTATION_RATE) {
-                    jpgManager mutationEngine(individual, individual, 15);
-                    mutationEngine.mutate(regex);
-                }
+        }
+        return candidate;
+    }
+    // The upper half goes first so removing it keeps the units of the lower half valid.
+    bool combine(std::vector<unsigned char>& current, const std::vector<unit>& units, const std::vector<size_t>& picked, reduction how) {
+        std::vector<unsigned char> candidate = apply(current, units, picked, how);
+        if (reproduces(*contexts[0], candidate)) {
+            current = std::move(candidate);
+            return true;
+        }
+        if (picked.size() == 1)
+            return false;
+        std::vector<size_t> lower(picked.begin(), picked.begin() + picked.size() / 2);
+        std::vector<size_t> upper(picked.begin() + picked.size() / 2, picked.end());
+        bool reduced = combine(current, units, upper, how);
+        return combine(current, units, lower, how) || reduced;
+    }
+    // Tries every unit on its own in parallel, then applies the ones that kept the crash.
+    bool pass(worker_pool& pool, std::vector<unsigned char>& current, const std::vector<unit>& units, reduction how) {
+        std::vector<char> keeps(units.size(), 0);
+        pool.run(static_cast<int>(units.size()), 1, [&](int worker, int i) {
+            const unit& u = units[i];
+            if (how == NORMALIZE && std::all_of(current.begin() + u.begin, current.begin() + u.end, [](unsigned char c) { return c == '0'; }))
+                return;
+            keeps[i] = reproduces(*contexts[worker], apply(current, units, { static_cast<size_t>(i) }, how));
+            });
+        std::vector<size_t> picked;
+        for (size_t i = 0; i < units.size(); ++i)
+            if (keeps[i])
+                picked.push_back(i);
+        return !picked.empty() && combine(current, units, picked, how);
+    }
+    void reduce(worker_pool& pool, std::vector<unsigned char>& current, reduction how, log_mask mask) {
+        if (how == REMOVE)
+            while (pass(pool, current, segmentsOf(current), REMOVE))
+                Logger::logProcessInfo(mask, "Removed segments, ", current.size(), " bytes left");
+        size_t chunkSize = std::max<size_t>(1, current.size() / 2);
+        for (;;) {
+            bool reduced = pass(pool, current, chunksOf(current, chunkSize), how);
+            if (reduced) {
+                Logger::logProcessInfo(mask, how == REMOVE ? "Removed" : "Normalized", " chunks of ", chunkSize, " bytes, ", current.size(), " bytes left");
+                continue;
             }
-            population = std::move(nextGeneration);
-            ++generation;
+            if (chunkSize == 1)
+                break;
+            chunkSize = (chunkSize + 1) / 2;
+        }
+    }
+public:
+    // A crash that needs the memory limit to happen needs the same limit to reproduce.
+    crash_minimizer(const std::string& p, const std::string& c, int t = 0, unsigned timeout = 0, unsigned ml = 0) : programPath(p), crashFile(c), numThreads(t), timeoutMs(timeout), memoryLimitMb(ml), bucket(0) {};
+    void execute(log_mask mask) {
+        std::ifstream inFile(crashFile, std::ios::binary);
+        if (!inFile) {
+            Logger::logError(mask, "Failed to open input file: ", crashFile);
+            return;
+        }
+        std::vector<unsigned char> current((std::istreambuf_iterator<char>(inFile)), std::istreambuf_iterator<char>());
+
+        worker_pool pool(numThreads);
+        contexts = makeContexts(pool, "min", programPath, false, memoryLimitMb, 0, mask);
+        if (contexts.empty())
+            return;
+        // Candidates that hang are killed and count as not reproducing.
+        unsigned timeout = calibrateTimeout(*contexts[0]->target, *contexts[0]->input, current, timeoutMs, mask);
+        if (!timeout)
+            return;
+        for (const auto& ctx : contexts)
+            ctx->target->setTimeout(timeout);
+
+        contexts[0]->input->write(current);
+        exec_result first = contexts[0]->target->run();
+        if (first.status != exec_status::CRASH && first.status != exec_status::UNEXPECTED) {
+            Logger::logError(mask, "The input does not crash the target: ", crashFile);
+            return;
         }
+        bucket = crash_index::keyOf(first);
+        size_t originalSize = current.size();
+        Logger::logProcessInfo(mask, "Minimizing ", originalSize, " bytes, bucket ", log_hex{ bucket });
+
+        reduce(pool, current, REMOVE, mask);
+        reduce(pool, current, NORMALIZE, mask);
+
+        fs::path source(crashFile);
+        std::string outPath = (source.parent_path() / (source.stem().string() + ".min" + source.extension().string())).string();
+        std::ofstream outFile(outPath, std::ios::binary);
+        outFile.write(reinterpret_cast<const char*>(current.data()), current.size());
+        long long execs = 1;
+        for (const auto& ctx : contexts)
+            execs += ctx->execs;
+        Logger::logProcessInfo(mask, "Minimized ", originalSize, " to ", current.size(), " bytes in ", execs, " execs. Saving file: ", outPath);
     }
 };
 
 class input_manager {
     std::string filename;
     std::string sample;
-    unsigned int iteration_count;
+    unsigned int iteration_count = 0;
     std::string algorithm;
     std::string logger_type;
     std::string logger_path;
+    unsigned int timeout = 0;
+    bool resume = false;
+    power_schedule schedule = power_schedule::FAST;
+    sync_options sync;
+    unsigned int memory_limit = 0;
+    perf_objective objective = perf_objective::NONE;
+    std::vector<std::string> diff_targets;
+    bool diff_files = false;
+    bool pin = true;
+    int workers = 0;
+    log_mask log_filter = log_category::ERROR | log_category::UNEXPECTED | log_category::CRASH;
+    bool complete = false;
 public:
     input_manager(int argc, char** argv) {
-        if (argc != 12) {
+        if (argc < 12 || argc > 38) {
             std::cout << "Please, give all arguments:\n";
             std::cout << "-e <PATH> - PATH to your app\n";
-            std::cout << "-s <PATH> - PATH to your example file to mutate\n";
+            std::cout << "-s <PATH> - PATH to your example file (or a directory of them) to mutate\n";
             std::cout << "-i <INT> - Number of iterations to be performed\n";
-            std::cout << "-a <GENETIC|DUMB> - Specify the algorithm to be used\n";
+            std::cout << "-a <GENETIC|DUMB|MINIMIZE|DIFF> - Specify the algorithm to be used\n";
             std::cout << "-l <STD> <PATH> - Specify the logger to be used\n";
+            std::cout << "-t <MS> - Optional timeout of one run, calibrated from the sample if not given\n";
+            std::cout << "--resume - Optional, continue the campaign from its last checkpoint\n";
+            std::cout << "-p <EXPLORE|FAST|RARE> - Optional power schedule of the DUMB queue, FAST if not given\n";
+            std::cout << "--sync <DIR> -M|-S <NAME> - Optional, share the DUMB campaign through DIR as primary (-M) or secondary (-S) instance NAME\n";
+            std::cout << "-m <MB> - Optional memory limit of the target\n";
+            std::cout << "--perf <TIME|MEMORY> - Optional, also queue DUMB inputs that rank among the slowest or most memory hungry\n";
+            std::cout << "--diff <PATH> - Another target to compare the app with in DIFF, may be repeated\n";
+            std::cout << "--diff-file - Optional, DIFF compares the file the targets write to $FUZZER_OUTPUT instead of their stdout\n";
+            std::cout << "-j <N> - Optional number of workers, one per free core if not given; DUMB runs without coverage feedback on more than one\n";
+            std::cout << "--log-filter <LIST> - Optional comma-separated log categories out of ERROR, PROCESS_INFO, UNEXPECTED and CRASH; all but PROCESS_INFO if not given\n";
+            std::cout << "--no-pin - Optional, let the workers and targets run on any core instead of a free one each\n";
         }
         else {
             for (int i = 0; i < argc; ++i) {
@@ -541,9 +5201,51 @@ public:
                     sample = argv[i + 1];
                 else if (std::string(argv[i]) == "-i")
                     iteration_count = stoi(std::string(argv[i + 1]));
+                else if (std::string(argv[i]) == "-t")
+                    timeout = stoi(std::string(argv[i + 1]));
+                else if (std::string(argv[i]) == "-m")
+                    memory_limit = stoi(std::string(argv[i + 1]));
+                else if (std::string(argv[i]) == "-j")
+                    workers = stoi(std::string(argv[i + 1]));
+                else if (std::string(argv[i]) == "--resume")
+                    resume = true;
+                else if (std::string(argv[i]) == "--diff" && i + 1 < argc)
+                    diff_targets.push_back(argv[i + 1]);
+                else if (std::string(argv[i]) == "--diff-file")
+                    diff_files = true;
+                else if (std::string(argv[i]) == "--no-pin")
+                    pin = false;
+                else if (std::string(argv[i]) == "--perf") {
+                    if (i + 1 >= argc || !parseObjective(argv[i + 1], objective)) {
+                        std::cout << "Available perf objectives: TIME and MEMORY\n";
+                        return;
+                    }
+                }
+                else if (std::string(argv[i]) == "--sync" && i + 1 < argc)
+                    sync.directory = argv[i + 1];
+                else if ((std::string(argv[i]) == "-M" || std::string(argv[i]) == "-S") && i + 1 < argc) {
+                    if (!sync_client::validName(argv[i + 1])) {
+                        std::cout << "Instance names may hold letters, digits, '-' and '_'\n";
+                        return;
+                    }
+                    sync.name = argv[i + 1];
+                    sync.primary = std::string(argv[i]) == "-M";
+                }
+                else if (std::string(argv[i]) == "--log-filter") {
+                    if (i + 1 >= argc || !parseLogFilter(argv[i + 1], log_filter)) {
+                        std::cout << "Available log categories: ERROR, PROCESS_INFO, UNEXPECTED and CRASH\n";
+                        return;
+                    }
+                }
+                else if (std::string(argv[i]) == "-p") {
+                    if (i + 1 >= argc || !parseSchedule(argv[i + 1], schedule)) {
+                        std::cout << "Available power schedules: EXPLORE, FAST and RARE\n";
+                        return;
+                    }
+                }
                 else if (std::string(argv[i]) == "-a") {
-                    if (std::string(argv[i + 1]) != "GENETIC" && std::string(argv[i + 1]) != "DUMB") {
-                        std::cout << "Available algorithms: GENETIC and DUMB\n";
+                    if (std::string(argv[i + 1]) != "GENETIC" && std::string(argv[i + 1]) != "DUMB" && std::string(argv[i + 1]) != "MINIMIZE" && std::string(argv[i + 1]) != "DIFF") {
+                        std::cout << "Available algorithms: GENETIC, DUMB, MINIMIZE and DIFF\n";
                         return;
                     }
                     algorithm = argv[i + 1];
@@ -557,8 +5259,21 @@ public:
                     logger_path = argv[i + 2];
                 }
             }
+            if (sync.enabled() != !sync.name.empty()) {
+                std::cout << "--sync needs -M or -S and the other way round\n";
+                return;
+            }
+            if ((algorithm == "DIFF") != !diff_targets.empty()) {
+                std::cout << "DIFF needs at least one --diff target and the other way round\n";
+                return;
+            }
+            complete = !filename.empty() && !sample.empty() && !algorithm.empty();
         }
     }
+    // Whether every required argument was given and valid.
+    bool valid() const {
+        return complete;
+    }
     std::string get_filename() {
         return filename;
     }
@@ -577,30 +5292,170 @@ public:
     std::string get_logger_path() {
         return logger_path;
     }
+    unsigned int get_timeout() {
+        return timeout;
+    }
+    power_schedule get_schedule() {
+        return schedule;
+    }
+    const sync_options& get_sync() {
+        return sync;
+    }
+    unsigned int get_memory_limit() {
+        return memory_limit;
+    }
+    perf_objective get_objective() {
+        return objective;
+    }
+    const std::vector<std::string>& get_diff_targets() {
+        return diff_targets;
+    }
+    bool get_diff_files() {
+        return diff_files;
+    }
+    bool get_pin() {
+        return pin;
+    }
+    int get_workers() {
+        return workers;
+    }
+    log_mask get_log_filter() {
+        return log_filter;
+    }
+    bool get_resume() {
+        return resume;
+    }
+};
+
+// What a campaign runs, as given in the GUI or on the command line.
+struct campaign_settings {
+    std::string program;
+    std::string sample;
+    int iterations = 0;
+    std::string algorithm;
+    std::string logger;
+    log_mask mask = log_category::NONE;
+    // 0 calibrates it from the sample.
+    unsigned timeout = 0;
+    // Continue from the checkpoint in the work directory instead of starting over.
+    bool resume = false;
+    power_schedule schedule = power_schedule::FAST;
+    // Other instances to share the campaign with; DUMB only.
+    sync_options sync;
+    // Address space cap of the target in MB; 0 is none.
+    unsigned memoryLimit = 0;
+    // Costly inputs that also join the queue; DUMB only.
+    perf_objective objective = perf_objective::NONE;
+    // DIFF compares the program with these, on stdout or with outputFiles on $FUZZER_OUTPUT.
+    std::vector<std::string> diffTargets;
+    bool outputFiles = false;
+    // Pin workers and their targets to cores no other instance holds.
+    bool pin = true;
+    // Worker threads of GENETIC and MINIMIZE, 0 is one per free core. DUMB runs on
+    // dumb_algorithm_th instead of its own loop when given more than one.
+    int workers = 0;
+};
+
+// One fuzzing run; both front ends start campaigns through it. run() blocks until the
+// algorithm is done or stopped, so the GUI calls it on a controller thread. pause, resume
+// and stop may be called from any thread while it runs.
+class campaign {
+    campaign_settings settings;
+public:
+    explicit campaign(campaign_settings s) : settings(std::move(s)) {};
+
+    // Statistics are sampled into the work directory of the sample while it runs, and
+    // handed to progress once a second.
+    void run(std::function<void(const stats_snapshot&)> progress = nullptr) {
+        campaign_control::global().reset();
+        campaign_stats::global().reset();
+        cpu_placement::global().reset(settings.pin);
+        stats_aggregator aggregator(campaign_stats::global(), workDirectory(settings.sample), std::move(progress));
+        if (settings.sync.enabled() && (settings.algorithm == "GENETIC" || settings.algorithm == "MINIMIZE" || settings.algorithm == "DIFF"))
+            Logger::logError(settings.mask, "Only DUMB campaigns sync, running ", settings.algorithm, " on its own");
+        if (settings.objective != perf_objective::NONE && (settings.algorithm == "GENETIC" || settings.algorithm == "MINIMIZE" || settings.algorithm == "DIFF"))
+            Logger::logError(settings.mask, "Only DUMB campaigns have a perf objective, running ", settings.algorithm, " for coverage");
+        bool parallelDumb = settings.algorithm == "DUMB" && settings.workers > 1;
+        if (parallelDumb && (settings.sync.enabled() || settings.resume || settings.objective != perf_objective::NONE))
+            Logger::logError(settings.mask, "DUMB on ", settings.workers, " workers does not sync, resume or rank costly inputs, running it without");
+        if (settings.algorithm == "GENETIC") {
+            genetic_algorithm fuzzing(settings.program, settings.sample, settings.workers, 0, settings.timeout, settings.resume, settings.memoryLimit);
+            fuzzing.execute(settings.mask);
+        }
+        else if (settings.algorithm == "MINIMIZE") {
+            crash_minimizer minimizer(settings.program, settings.sample, settings.workers, settings.timeout, settings.memoryLimit);
+            minimizer.execute(settings.mask);
+        }
+        else if (settings.algorithm == "DIFF") {
+            std::vector<std::string> programs{ settings.program };
+            programs.insert(programs.end(), settings.diffTargets.begin(), settings.diffTargets.end());
+            differential_algorithm fuzzing(programs, settings.sample, settings.iterations, 0, settings.timeout, settings.outputFiles, settings.memoryLimit);
+            fuzzing.execute(settings.mask);
+        }
+        else if (parallelDumb) {
+            dumb_algorithm_th fuzzing(settings.program, settings.sample, settings.iterations, 0, settings.workers, 0, settings.timeout, settings.memoryLimit);
+            fuzzing.execute(settings.mask);
+        }
+        else {
+            dumb_algorithm fuzzing(settings.program, settings.sample, settings.iterations, 0, 0, settings.timeout, settings.resume, settings.schedule, settings.sync, settings.memoryLimit, settings.objective);
+            fuzzing.execute(settings.mask);
+        }
+        Logger::flush();
+    }
+    void pause() {
+        campaign_control::global().pause();
+    }
+    void resume() {
+        campaign_control::global().resume();
+    }
+    void stop() {
+        campaign_control::global().stop();
+    }
+    bool paused() const {
+        return campaign_control::global().paused();
+    }
+    const campaign_settings& config() const {
+        return settings;
+    }
 };
 
 class Fuzzer {
 public:
-    /*void run(int argc, char** argv) {
+    // Headless front end: runs the campaign given on the command line and returns the exit code.
+    int run(int argc, char** argv) {
         input_manager i(argc, argv);
-        std::string testedProgram = i.get_filename();
-        std::string sampleFile = i.get_sample();
-        int iterations = i.get_iteration_count();
-        std::string algorithm = i.get_algorithm();
+        if (!i.valid())
+            return 2;
+        campaign_settings settings;
+        settings.program = i.get_filename();
+        settings.sample = i.get_sample();
+        settings.iterations = static_cast<int>(i.get_iteration_count());
+        settings.algorithm = i.get_algorithm();
+        settings.logger = i.get_logger_type();
+        settings.mask = i.get_log_filter();
+        settings.timeout = i.get_timeout();
+        settings.resume = i.get_resume();
+        settings.schedule = i.get_schedule();
+        settings.sync = i.get_sync();
+        settings.memoryLimit = i.get_memory_limit();
+        settings.objective = i.get_objective();
+        settings.diffTargets = i.get_diff_targets();
+        settings.outputFiles = i.get_diff_files();
+        settings.pin = i.get_pin();
+        settings.workers = i.get_workers();
 
-        dumb_algorithm fuzzing(testedProgram, sampleFile, iterations, 0);
-        fuzzing.execute();
-    }*/
-
-    void gui_run(std::string pp, std::string fp, int i, std::string a, std::string l, std::regex regex) {
-        dumb_algorithm fuzzing(pp, fp, i, 0);
-        fuzzing.execute(regex);
+        campaign fuzzing(settings);
+        fuzzing.run();
+        std::cout << "Crashes detected: " << crashes_detected << " (" << unique_crashes_detected << " unique)\n"
+            << "Timeouts: " << timeouts_detected << " (" << unique_hangs_detected << " unique hangs)" << std::endl;
+        return 0;
     }
 };
 enum class AlgorithmType
 {
     RANDOM,
-    GENETIC
+    GENETIC,
+    MINIMIZE
 };
 
 enum class LoggerType
@@ -608,6 +5463,7 @@ enum class LoggerType
     STD
 };
 
+#ifndef FUZZER_HEADLESS
 class MainFrame : public wxFrame
 {
 public:
@@ -624,8 +5480,15 @@ public:
         sampleTextCtrl = new wxTextCtrl(panel, wxID_ANY);
         wxStaticText* iterationsLabel = new wxStaticText(panel, wxID_ANY, "Iterations:");
         iterationsSpinCtrl = new wxSpinCtrl(panel, wxID_ANY, wxEmptyString, wxDefaultPosition, wxDefaultSize, wxSP_ARROW_KEYS, 1, INT_MAX, 1);
+        wxStaticText* timeoutLabel = new wxStaticText(panel, wxID_ANY, "Timeout (ms, 0 = calibrate):");
+        timeoutSpinCtrl = new wxSpinCtrl(panel, wxID_ANY, wxEmptyString, wxDefaultPosition, wxDefaultSize, wxSP_ARROW_KEYS, 0, INT_MAX, 0);
         wxStaticText* algorithmLabel = new wxStaticText(panel, wxID_ANY, "Algorithm Type:");
         algorithmChoice = new wxChoice(panel, wxID_ANY);
+        wxStaticText* diffLabel = new wxStaticText(panel, wxID_ANY, "DIFF Targets (one path per line):");
+        diffTextCtrl = new wxTextCtrl(panel, wxID_ANY, wxEmptyString, wxDefaultPosition, wxDefaultSize, wxTE_MULTILINE);
+        diffFileCheckBox = new wxCheckBox(panel, wxID_ANY, "DIFF compares $FUZZER_OUTPUT instead of stdout");
+        wxStaticText* scheduleLabel = new wxStaticText(panel, wxID_ANY, "Power Schedule:");
+        scheduleChoice = new wxChoice(panel, wxID_ANY);
         wxStaticText* loggerLabel = new wxStaticText(panel, wxID_ANY, "Logger Type:");
         loggerChoice = new wxChoice(panel, wxID_ANY);
         wxStaticText* logFilterLabel = new wxStaticText(panel, wxID_ANY, "Log Filter:");
@@ -633,7 +5496,12 @@ public:
         processInfoCheckBox = new wxCheckBox(panel, wxID_ANY, "Process Info");
         unexpectedCheckBox = new wxCheckBox(panel, wxID_ANY, "Unexpected");
         crashCheckBox = new wxCheckBox(panel, wxID_ANY, "Crash");
+        resumeCheckBox = new wxCheckBox(panel, wxID_ANY, "Resume from checkpoint");
         logButton = new wxButton(panel, wxID_ANY, "Run");
+        pauseButton = new wxButton(panel, wxID_ANY, "Pause");
+        stopButton = new wxButton(panel, wxID_ANY, "Stop");
+        pauseButton->Disable();
+        stopButton->Disable();
         logTextCtrl = new wxTextCtrl(panel, wxID_ANY, wxEmptyString, wxDefaultPosition, wxDefaultSize, wxTE_MULTILINE | wxTE_READONLY);
 
         // Add the controls to the sizer
@@ -643,8 +5511,15 @@ public:
         sizer->Add(sampleTextCtrl, 0, wxALL, 5);
         sizer->Add(iterationsLabel, 0, wxALL, 5);
         sizer->Add(iterationsSpinCtrl, 0, wxALL, 5);
+        sizer->Add(timeoutLabel, 0, wxALL, 5);
+        sizer->Add(timeoutSpinCtrl, 0, wxALL, 5);
         sizer->Add(algorithmLabel, 0, wxALL, 5);
         sizer->Add(algorithmChoice, 0, wxALL, 5);
+        sizer->Add(diffLabel, 0, wxALL, 5);
+        sizer->Add(diffTextCtrl, 0, wxEXPAND | wxALL, 5);
+        sizer->Add(diffFileCheckBox, 0, wxALL, 5);
+        sizer->Add(scheduleLabel, 0, wxALL, 5);
+        sizer->Add(scheduleChoice, 0, wxALL, 5);
         sizer->Add(loggerLabel, 0, wxALL, 5);
         sizer->Add(loggerChoice, 0, wxALL, 5);
         sizer->Add(logFilterLabel, 0, wxALL, 5);
@@ -652,62 +5527,179 @@ public:
         sizer->Add(processInfoCheckBox, 0, wxALL, 5);
         sizer->Add(unexpectedCheckBox, 0, wxALL, 5);
         sizer->Add(crashCheckBox, 0, wxALL, 5);
-        sizer->Add(logButton, 0, wxALL, 5);
+        sizer->Add(resumeCheckBox, 0, wxALL, 5);
+        wxBoxSizer* buttonSizer = new wxBoxSizer(wxHORIZONTAL);
+        buttonSizer->Add(logButton, 0, wxALL, 5);
+        buttonSizer->Add(pauseButton, 0, wxALL, 5);
+        buttonSizer->Add(stopButton, 0, wxALL, 5);
+        sizer->Add(buttonSizer, 0, wxALL, 0);
         sizer->Add(logTextCtrl, 1, wxEXPAND | wxALL, 5);
 
         panel->SetSizer(sizer);
 
         // Bind events
         logButton->Bind(wxEVT_BUTTON, &MainFrame::OnLogButtonClicked, this);
+        pauseButton->Bind(wxEVT_BUTTON, &MainFrame::OnPauseButtonClicked, this);
+        stopButton->Bind(wxEVT_BUTTON, &MainFrame::OnStopButtonClicked, this);
 
         // Populate algorithm choice
         algorithmChoice->Append("RANDOM");
         algorithmChoice->Append("GENETIC");
+        algorithmChoice->Append("MINIMIZE");
+        algorithmChoice->Append("DIFF");
+
+        // Populate power schedule choice
+        for (power_schedule schedule : { power_schedule::EXPLORE, power_schedule::FAST, power_schedule::RARE })
+            scheduleChoice->Append(scheduleName(schedule));
+        scheduleChoice->SetSelection(static_cast<int>(power_schedule::FAST));
 
         // Populate logger choice
         loggerChoice->Append("STD");
     }
+    // Closing the window stops a running campaign and waits for it.
+    ~MainFrame()
+    {
+        if (campaignThread.joinable()) {
+            running->stop();
+            campaignThread.join();
+        }
+    }
 
 private:
+    // The campaign runs on a controller thread, which posts its statistics back once a second.
     void OnLogButtonClicked(wxCommandEvent& event)
     {
+        if (campaignThread.joinable())
+            return;
         wxString programPath = programTextCtrl->GetValue();
         wxString sampleFilePath = sampleTextCtrl->GetValue();
         int iterationsNumber = iterationsSpinCtrl->GetValue();
+        int timeout = timeoutSpinCtrl->GetValue();
         wxString algorithmType = algorithmChoice->GetString(algorithmChoice->GetSelection());
         wxString loggerType = loggerChoice->GetString(loggerChoice->GetSelection());
 
         wxString logsOfInterest = "NOT_MATCHING";
-        if (errorCheckBox->GetValue())
+        log_mask mask = log_category::NONE;
+        if (errorCheckBox->GetValue()) {
             logsOfInterest += "|ERROR";
-        if (processInfoCheckBox->GetValue())
+            mask |= log_category::ERROR;
+        }
+        if (processInfoCheckBox->GetValue()) {
             logsOfInterest += "|PROCESS INFO";
-        if (unexpectedCheckBox->GetValue())
+            mask |= log_category::PROCESS_INFO;
+        }
+        if (unexpectedCheckBox->GetValue()) {
             logsOfInterest += "|UNEXPECTED";
-        if (crashCheckBox->GetValue())
+            mask |= log_category::UNEXPECTED;
+        }
+        if (crashCheckBox->GetValue()) {
             logsOfInterest += "|CRASH";
-        
-        std::regex regex(logsOfInterest);
-        Fuzzer fuzzer;
-        fuzzer.gui_run(programPath.ToStdString(), sampleFilePath.ToStdString(), iterationsNumber, algorithmType.ToStdString(), loggerType.ToStdString(), regex);
+            mask |= log_category::CRASH;
+        }
 
-        wxString output = wxString::Format("Program Path: %s\nSample File Path: %s\nIterations: %d\nAlgorithm Type: %s\nLogger Type: %s\nLogs of Interest: %s\nCrashes detected: %d",
-            programPath, sampleFilePath, iterationsNumber, algorithmType, loggerType, logsOfInterest, crashes_detected);
+        runSummary = wxString::Format("Program Path: %s\nSample File Path: %s\nIterations: %d\nAlgorithm Type: %s\nLogger Type: %s\nLogs of Interest: %s",
+            programPath, sampleFilePath, iterationsNumber, algorithmType, loggerType, logsOfInterest);
+        logTextCtrl->SetValue(runSummary + "\nStarting...");
+
+        campaign_settings settings;
+        settings.program = programPath.ToStdString();
+        settings.sample = sampleFilePath.ToStdString();
+        settings.iterations = iterationsNumber;
+        settings.algorithm = algorithmType.ToStdString();
+        settings.logger = loggerType.ToStdString();
+        settings.mask = mask;
+        settings.timeout = static_cast<unsigned>(timeout);
+        settings.resume = resumeCheckBox->GetValue();
+        parseSchedule(scheduleChoice->GetString(scheduleChoice->GetSelection()).ToStdString(), settings.schedule);
+        if (settings.algorithm == "DIFF") {
+            for (int line = 0; line < diffTextCtrl->GetNumberOfLines(); ++line) {
+                std::string path = diffTextCtrl->GetLineText(line).Trim().Trim(false).ToStdString();
+                if (!path.empty())
+                    settings.diffTargets.push_back(path);
+            }
+            settings.outputFiles = diffFileCheckBox->GetValue();
+        }
+        running.reset(new campaign(settings));
 
-        logTextCtrl->SetValue(output);
+        logButton->Disable();
+        pauseButton->SetLabel("Pause");
+        pauseButton->Enable();
+        stopButton->Enable();
+        campaignThread = std::thread([this] {
+            running->run([this](const stats_snapshot& s) {
+                CallAfter([this, s] { OnProgress(s); });
+                });
+            CallAfter([this] { OnCampaignFinished(); });
+            });
+    }
+    void OnPauseButtonClicked(wxCommandEvent& event)
+    {
+        if (!running)
+            return;
+        if (running->paused()) {
+            running->resume();
+            pauseButton->SetLabel("Pause");
+        }
+        else {
+            running->pause();
+            pauseButton->SetLabel("Resume");
+        }
+    }
+    void OnStopButtonClicked(wxCommandEvent& event)
+    {
+        if (!running)
+            return;
+        running->stop();
+        pauseButton->Disable();
+        stopButton->Disable();
+    }
+    void OnProgress(const stats_snapshot& s)
+    {
+        if (running)
+            logTextCtrl->SetValue(runSummary + (running->paused() ? "\nPaused\n" : "\n") + describe(s));
+    }
+    void OnCampaignFinished()
+    {
+        campaignThread.join();
+        running.reset();
+        pauseButton->Disable();
+        stopButton->Disable();
+        wxString output = runSummary + wxString::Format("\nCrashes detected: %d (%d unique)\nTimeouts: %d (%d unique hangs)\n",
+            crashes_detected, unique_crashes_detected, timeouts_detected, unique_hangs_detected);
+        logTextCtrl->SetValue(output + describe(campaign_stats::global().published()));
+        logButton->Enable();
+    }
+    static wxString describe(const stats_snapshot& s)
+    {
+        return wxString::Format("Run time: %.1f s\nExecs: %llu (%.0f/s)\nCrashes: %llu (%llu unique)\nHangs: %llu (%llu unique)\nCorpus: %llu inputs, %llu edges\nExec time p50/p99: %llu/%llu us",
+            s.seconds, static_cast<unsigned long long>(s.execs), s.execsPerSecond,
+            static_cast<unsigned long long>(s.crashes), static_cast<unsigned long long>(s.uniqueCrashes),
+            static_cast<unsigned long long>(s.hangs), static_cast<unsigned long long>(s.uniqueHangs),
+            static_cast<unsigned long long>(s.corpusSize), static_cast<unsigned long long>(s.edges),
+            static_cast<unsigned long long>(s.latencyPercentile(0.5)), static_cast<unsigned long long>(s.latencyPercentile(0.99)));
     }
 
     wxTextCtrl* programTextCtrl;
     wxTextCtrl* sampleTextCtrl;
     wxSpinCtrl* iterationsSpinCtrl;
+    wxSpinCtrl* timeoutSpinCtrl;
     wxChoice* algorithmChoice;
+    wxTextCtrl* diffTextCtrl;
+    wxCheckBox* diffFileCheckBox;
+    wxChoice* scheduleChoice;
     wxChoice* loggerChoice;
     wxCheckBox* errorCheckBox;
     wxCheckBox* processInfoCheckBox;
     wxCheckBox* unexpectedCheckBox;
     wxCheckBox* crashCheckBox;
+    wxCheckBox* resumeCheckBox;
     wxButton* logButton;
+    wxButton* pauseButton;
+    wxButton* stopButton;
     wxTextCtrl* logTextCtrl;
+    wxString runSummary;
+    std::unique_ptr<campaign> running;
+    std::thread campaignThread;
 
     wxDECLARE_EVENT_TABLE();
 };
@@ -730,3 +5722,4 @@ bool MyApp::OnInit()
 }
 
 wxIMPLEMENT_APP(MyApp);
+#endif
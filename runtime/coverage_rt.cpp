@@ -0,0 +1,153 @@
+// Coverage runtime for instrumented targets. It records edge hit counts into the
+// fuzzer's shared bitmap (passed on COV_FD) and falls back to a private area when the
+// target runs on its own. Build it without instrumentation and link it into the target:
+//   g++ -O2 -c runtime/coverage_rt.cpp
+//   clang++ -fsanitize-coverage=trace-pc-guard target.cpp coverage_rt.o    (clang)
+//   g++ -fsanitize-coverage=trace-pc target.cpp coverage_rt.o              (gcc)
+// Add trace-cmp to either for the comparison log (CMP_FD), which feeds the dictionary.
+#include <sys/mman.h>
+#include <cstdint>
+#include <cstdlib>
+#include <cstring>
+
+namespace {
+
+// Must match MAP_SIZE and COV_FD in project.cpp.
+constexpr size_t MAP_SIZE = 1 << 16;
+constexpr int COV_FD = 197;
+
+// Must match CMP_FD and the cmp_log layout in project.cpp.
+constexpr int CMP_FD = 195;
+constexpr uint32_t CMP_ENTRIES = 4096;
+constexpr uint32_t CMP_CONST = 1;
+
+struct cmp_entry {
+    uint32_t size;
+    uint32_t flags;
+    uint64_t first;
+    uint64_t second;
+};
+
+struct cmp_table {
+    uint32_t count;
+    uint32_t generation;
+    cmp_entry entries[CMP_ENTRIES];
+};
+
+uint8_t fallbackArea[MAP_SIZE];
+uint8_t* area = fallbackArea;
+uint32_t nextGuard = 1;
+thread_local uintptr_t prevLocation;
+
+cmp_table* comparisons;
+uint32_t seenGeneration;
+uint8_t seen[1 << 14];
+
+__attribute__((constructor(101))) void attachMap() {
+    if (std::getenv("FUZZER_COV")) {
+        void* shared = mmap(nullptr, MAP_SIZE, PROT_READ | PROT_WRITE, MAP_SHARED, COV_FD, 0);
+        if (shared != MAP_FAILED)
+            area = static_cast<uint8_t*>(shared);
+    }
+    if (std::getenv("FUZZER_CMP")) {
+        void* shared = mmap(nullptr, sizeof(cmp_table), PROT_READ | PROT_WRITE, MAP_SHARED, CMP_FD, 0);
+        if (shared != MAP_FAILED)
+            comparisons = static_cast<cmp_table*>(shared);
+    }
+}
+
+// Logs a comparison that failed, once per run for the same site and operands (the fuzzer
+// bumps the generation before every run). Loops would fill the table otherwise.
+void logComparison(uint32_t size, uint32_t flags, uint64_t first, uint64_t second, void* site) {
+    cmp_table* table = comparisons;
+    if (!table || first == second)
+        return;
+    if (table->generation != seenGeneration) {
+        std::memset(seen, 0, sizeof(seen));
+        seenGeneration = table->generation;
+    }
+    uint64_t key = (reinterpret_cast<uintptr_t>(site) ^ first * 0x9E3779B97F4A7C15ull ^ second * 0xC2B2AE3D27D4EB4Full) * 0xFF51AFD7ED558CCDull;
+    uint8_t& slot = seen[key >> 50];
+    if (slot)
+        return;
+    slot = 1;
+    uint32_t n = table->count;
+    if (n >= CMP_ENTRIES)
+        return;
+    table->entries[n] = {size, flags, first, second};
+    table->count = n + 1;
+}
+
+}
+
+// Every image (the executable or a shared library) has its own __dso_handle.
+extern "C" void* __dso_handle;
+
+// clang: every edge gets a guard that holds its slot in the map.
+extern "C" void __sanitizer_cov_trace_pc_guard_init(uint32_t* start, uint32_t* stop) {
+    if (start == stop || *start)
+        return;
+    for (uint32_t* guard = start; guard < stop; ++guard) {
+        *guard = nextGuard;
+        nextGuard = nextGuard % (MAP_SIZE - 1) + 1;
+    }
+}
+
+extern "C" void __sanitizer_cov_trace_pc_guard(uint32_t* guard) {
+    area[*guard]++;
+}
+
+// gcc: only basic blocks are reported, so edges are hashed from the previous and current
+// block. Offsets within the image keep slots stable under ASLR, also in a library.
+extern "C" void __sanitizer_cov_trace_pc() {
+    uintptr_t pc = reinterpret_cast<uintptr_t>(__builtin_return_address(0)) - reinterpret_cast<uintptr_t>(&__dso_handle);
+    uintptr_t cur = (pc * 0x9E3779B97F4A7C15ull) >> 48;
+    area[(cur ^ prevLocation) & (MAP_SIZE - 1)]++;
+    prevLocation = cur >> 1;
+}
+
+// trace-cmp: the operands of every integer comparison. The const variants have the
+// constant first.
+extern "C" void __sanitizer_cov_trace_cmp1(uint8_t a, uint8_t b) {
+    logComparison(1, 0, a, b, __builtin_return_address(0));
+}
+
+extern "C" void __sanitizer_cov_trace_cmp2(uint16_t a, uint16_t b) {
+    logComparison(2, 0, a, b, __builtin_return_address(0));
+}
+
+extern "C" void __sanitizer_cov_trace_cmp4(uint32_t a, uint32_t b) {
+    logComparison(4, 0, a, b, __builtin_return_address(0));
+}
+
+extern "C" void __sanitizer_cov_trace_cmp8(uint64_t a, uint64_t b) {
+    logComparison(8, 0, a, b, __builtin_return_address(0));
+}
+
+extern "C" void __sanitizer_cov_trace_const_cmp1(uint8_t a, uint8_t b) {
+    logComparison(1, CMP_CONST, a, b, __builtin_return_address(0));
+}
+
+extern "C" void __sanitizer_cov_trace_const_cmp2(uint16_t a, uint16_t b) {
+    logComparison(2, CMP_CONST, a, b, __builtin_return_address(0));
+}
+
+extern "C" void __sanitizer_cov_trace_const_cmp4(uint32_t a, uint32_t b) {
+    logComparison(4, CMP_CONST, a, b, __builtin_return_address(0));
+}
+
+extern "C" void __sanitizer_cov_trace_const_cmp8(uint64_t a, uint64_t b) {
+    logComparison(8, CMP_CONST, a, b, __builtin_return_address(0));
+}
+
+// cases[0] is the number of cases, cases[1] the width of the value in bits.
+extern "C" void __sanitizer_cov_trace_switch(uint64_t value, uint64_t* cases) {
+    void* site = __builtin_return_address(0);
+    uint32_t size = static_cast<uint32_t>(cases[1] / 8);
+    for (uint64_t i = 0; i < cases[0]; ++i)
+        logComparison(size ? size : 1, CMP_CONST, cases[2 + i], value, site);
+}
+
+// Floating point comparisons do not make useful tokens.
+extern "C" void __sanitizer_cov_trace_cmpf(float, float) {}
+extern "C" void __sanitizer_cov_trace_cmpd(double, double) {}
@@ -0,0 +1,177 @@
+// Fork-server runtime for the fuzzer's forkserver executor.
+//
+// Preload it into a dynamically linked target (the fuzzer sets LD_PRELOAD) or link it
+// into the target directly:
+//   g++ -O2 -shared -fPIC -o forkserver_rt.so runtime/forkserver_rt.cpp -ldl
+//
+// It wraps __libc_start_main, so the server starts after dynamic linking and static
+// initialization and stops right before main. For every request on the control pipe it
+// forks a child that continues into main, and reports the child's pid, then its wait status
+// together with the CPU time and peak memory it used.
+//
+// It also installs handlers for crash signals that describe the crash (signal, faulting
+// pc and a hash of the top stack frames) in a page shared with the fuzzer.
+#include <dlfcn.h>
+#include <execinfo.h>
+#include <signal.h>
+#include <ucontext.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/prctl.h>
+#include <sys/resource.h>
+#include <sys/wait.h>
+#include <cstdint>
+#include <cstdlib>
+#include <initializer_list>
+
+namespace {
+
+// Must match FORKSRV_FD and FORKSRV_HELLO in project.cpp.
+constexpr int FORKSRV_FD = 198;
+constexpr uint32_t FORKSRV_HELLO = 0x46535256;
+
+// Must match forksrv_status in project.cpp.
+struct forksrv_status {
+    int32_t status;
+    uint32_t reserved;
+    uint64_t cpuMicros;
+    uint64_t peakRssKb;
+};
+
+// Must match CRASH_FD and crash_report in project.cpp.
+constexpr int CRASH_FD = 196;
+constexpr int STACK_DEPTH = 8;
+
+struct crash_report {
+    uint32_t valid;
+    int32_t signal;
+    uint64_t pc;
+    uint64_t address;
+    uint64_t stackHash;
+};
+
+crash_report* report;
+char alternateStack[64 * 1024];
+
+// Offsets inside the module keep pcs comparable across ASLR and restarts.
+uint64_t moduleOffset(void* address) {
+    Dl_info info;
+    if (dladdr(address, &info) && info.dli_fbase)
+        return reinterpret_cast<uintptr_t>(address) - reinterpret_cast<uintptr_t>(info.dli_fbase);
+    return reinterpret_cast<uintptr_t>(address);
+}
+
+void crashHandler(int sig, siginfo_t* info, void* context) {
+    if (report) {
+        uintptr_t pc = 0;
+#if defined(__x86_64__)
+        pc = static_cast<uintptr_t>(static_cast<ucontext_t*>(context)->uc_mcontext.gregs[REG_RIP]);
+#elif defined(__aarch64__)
+        pc = static_cast<uintptr_t>(static_cast<ucontext_t*>(context)->uc_mcontext.pc);
+#endif
+        // The unwinder goes through the signal frame; hashing starts at the faulting frame.
+        void* frames[32];
+        int count = backtrace(frames, 32);
+        int first = -1;
+        for (int i = 0; i < count && first < 0; ++i)
+            if (reinterpret_cast<uintptr_t>(frames[i]) == pc)
+                first = i;
+        uint64_t hash = 0xcbf29ce484222325ull;
+        for (int i = first; first >= 0 && i < count && i < first + STACK_DEPTH; ++i) {
+            hash ^= moduleOffset(frames[i]);
+            hash *= 0x100000001b3ull;
+        }
+        report->signal = sig;
+        report->pc = pc ? moduleOffset(reinterpret_cast<void*>(pc)) : 0;
+        report->address = reinterpret_cast<uintptr_t>(info->si_addr);
+        report->stackHash = first >= 0 ? hash : 0;
+        report->valid = 1;
+    }
+    // SA_RESETHAND restored the default action.
+    raise(sig);
+}
+
+void installCrashHandlers() {
+    if (!std::getenv("FUZZER_CRASH"))
+        return;
+    unsetenv("FUZZER_CRASH");
+    void* page = mmap(nullptr, sizeof(crash_report), PROT_READ | PROT_WRITE, MAP_SHARED, CRASH_FD, 0);
+    if (page == MAP_FAILED)
+        return;
+    report = static_cast<crash_report*>(page);
+    // The first backtrace call may allocate while loading the unwinder; do it now.
+    void* warmup[1];
+    backtrace(warmup, 1);
+
+    stack_t altStack = {};
+    altStack.ss_sp = alternateStack;
+    altStack.ss_size = sizeof(alternateStack);
+    sigaltstack(&altStack, nullptr);
+    struct sigaction action = {};
+    action.sa_sigaction = crashHandler;
+    action.sa_flags = SA_SIGINFO | SA_RESETHAND | SA_ONSTACK;
+    sigemptyset(&action.sa_mask);
+    for (int sig : { SIGSEGV, SIGBUS, SIGILL, SIGFPE, SIGABRT, SIGTRAP })
+        sigaction(sig, &action, nullptr);
+}
+
+using main_fn = int (*)(int, char**, char**);
+using start_fn = int (*)(main_fn, int, char**, void (*)(), void (*)(), void (*)(), void*);
+
+main_fn realMain;
+
+void forkServer() {
+    if (!std::getenv("FUZZER_FORKSRV"))
+        return;
+    // A target that links the runtime and also gets it preloaded must start only one server.
+    unsetenv("FUZZER_FORKSRV");
+    // If the fuzzer is killed, the server and a child it is waiting for (maybe a hang) go too.
+    prctl(PR_SET_PDEATHSIG, SIGKILL);
+    uint32_t hello = FORKSRV_HELLO;
+    if (write(FORKSRV_FD + 1, &hello, sizeof(hello)) != sizeof(hello))
+        return;
+
+    for (;;) {
+        uint32_t go;
+        if (read(FORKSRV_FD, &go, sizeof(go)) != sizeof(go))
+            _exit(0);
+
+        pid_t child = fork();
+        if (child < 0)
+            _exit(1);
+        if (child == 0) {
+            prctl(PR_SET_PDEATHSIG, SIGKILL);
+            close(FORKSRV_FD);
+            close(FORKSRV_FD + 1);
+            return;
+        }
+
+        int32_t pid = child;
+        if (write(FORKSRV_FD + 1, &pid, sizeof(pid)) != sizeof(pid))
+            _exit(1);
+        // The child is a fresh process, so its usage is its own run's. One write keeps the
+        // report whole for the fuzzer's single read.
+        forksrv_status report = {};
+        struct rusage usage = {};
+        if (wait4(child, &report.status, 0, &usage) < 0)
+            _exit(1);
+        report.cpuMicros = (usage.ru_utime.tv_sec + usage.ru_stime.tv_sec) * 1000000ull + usage.ru_utime.tv_usec + usage.ru_stime.tv_usec;
+        report.peakRssKb = static_cast<uint64_t>(usage.ru_maxrss);
+        if (write(FORKSRV_FD + 1, &report, sizeof(report)) != sizeof(report))
+            _exit(1);
+    }
+}
+
+int wrappedMain(int argc, char** argv, char** envp) {
+    installCrashHandlers();
+    forkServer();
+    return realMain(argc, argv, envp);
+}
+
+}
+
+extern "C" int __libc_start_main(main_fn main, int argc, char** argv, void (*init)(), void (*fini)(), void (*rtld_fini)(), void* stack_end) {
+    start_fn realStart = reinterpret_cast<start_fn>(dlsym(RTLD_NEXT, "__libc_start_main"));
+    realMain = main;
+    return realStart(wrappedMain, argc, argv, init, fini, rtld_fini, stack_end);
+}
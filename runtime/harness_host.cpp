@@ -0,0 +1,102 @@
+// Host process for the fuzzer's in-process executor.
+//
+//   g++ -O2 -o harness_host runtime/harness_host.cpp -ldl
+//
+// The fuzzer starts it as `harness_host <target library> <input file>`. It loads the library,
+// which must export
+//   extern "C" int fuzz_one(const uint8_t* data, size_t size);
+// and calls it once for every request on the control socket, on the current contents of
+// the input file, and answers with its return value and what the call cost: CPU time and
+// peak resident memory. A crash or a hang kills the host; the fuzzer then starts a new one.
+// The fuzzer preloads forkserver_rt.so into it for the crash reports, and the library's
+// coverage runtime finds the bitmap the usual way.
+//
+// The peak of a call is the process high-water mark, reset through /proc/self/clear_refs
+// before the call. Linux also counts the high-water mark of the process image exec replaced
+// (a copy of the fuzzer) in it, so a call only reports a peak above that floor, and without
+// clear_refs one above every earlier call; otherwise it reports 0.
+#include <dlfcn.h>
+#include <fcntl.h>
+#include <sys/resource.h>
+#include <sys/socket.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#include <cstddef>
+#include <cstdint>
+#include <cstdio>
+#include <vector>
+
+namespace {
+
+// Must match HARNESS_FD and HARNESS_HELLO in project.cpp.
+constexpr int HARNESS_FD = 198;
+constexpr uint32_t HARNESS_HELLO = 0x48524e53;
+
+// Must match harness_reply in project.cpp.
+struct harness_reply {
+    int32_t value;
+    uint32_t reserved;
+    uint64_t cpuMicros;
+    uint64_t peakRssKb;
+};
+
+using fuzz_one_fn = int (*)(const uint8_t*, size_t);
+
+uint64_t cpuMicros(const rusage& usage) {
+    return (usage.ru_utime.tv_sec + usage.ru_stime.tv_sec) * 1000000ull + usage.ru_utime.tv_usec + usage.ru_stime.tv_usec;
+}
+
+}
+
+int main(int argc, char** argv) {
+    if (argc < 3)
+        return 2;
+    void* library = dlopen(argv[1], RTLD_NOW | RTLD_LOCAL);
+    if (!library)
+        return 2;
+    fuzz_one_fn fuzzOne = reinterpret_cast<fuzz_one_fn>(dlsym(library, "fuzz_one"));
+    int input = open(argv[2], O_RDONLY | O_CLOEXEC);
+    if (!fuzzOne || input < 0)
+        return 2;
+    uint32_t hello = HARNESS_HELLO;
+    if (send(HARNESS_FD, &hello, sizeof(hello), MSG_NOSIGNAL) != sizeof(hello))
+        return 2;
+
+    int clearRefs = open("/proc/self/clear_refs", O_WRONLY | O_CLOEXEC);
+    rusage usage = {};
+    getrusage(RUSAGE_SELF, &usage);
+    uint64_t cpuBefore = cpuMicros(usage);
+    uint64_t peakFloor = static_cast<uint64_t>(usage.ru_maxrss);
+
+    std::vector<uint8_t> buffer;
+    for (;;) {
+        uint32_t go;
+        if (recv(HARNESS_FD, &go, sizeof(go), MSG_WAITALL) != sizeof(go))
+            return 0;
+        struct stat info;
+        if (fstat(input, &info) < 0)
+            return 2;
+        buffer.resize(static_cast<size_t>(info.st_size));
+        ssize_t size = pread(input, buffer.data(), buffer.size(), 0);
+        if (clearRefs >= 0 && write(clearRefs, "5", 1) != 1) {
+            close(clearRefs);
+            clearRefs = -1;
+        }
+        harness_reply reply = {};
+        reply.value = fuzzOne(buffer.data(), size > 0 ? static_cast<size_t>(size) : 0);
+        // The fuzzer reads stdout after every call, so nothing may stay in the buffer.
+        fflush(stdout);
+        getrusage(RUSAGE_SELF, &usage);
+        uint64_t cpuAfter = cpuMicros(usage);
+        reply.cpuMicros = cpuAfter - cpuBefore;
+        cpuBefore = cpuAfter;
+        uint64_t peak = static_cast<uint64_t>(usage.ru_maxrss);
+        if (peak > peakFloor) {
+            reply.peakRssKb = peak;
+            if (clearRefs < 0)
+                peakFloor = peak;
+        }
+        if (send(HARNESS_FD, &reply, sizeof(reply), MSG_NOSIGNAL) != sizeof(reply))
+            return 0;
+    }
+}
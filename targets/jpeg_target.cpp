@@ -0,0 +1,203 @@
+// Small JPEG front end for trying the fuzzer locally. It walks the marker segments the
+// way a decoder does before entropy decoding and has four deliberate bugs:
+//  - DQT with a table id above 3 writes through a missing table (SIGSEGV),
+//  - DHT whose code counts add up to more than 256 symbols (SIGABRT),
+//  - SOS naming a component that the frame does not have (SIGSEGV),
+//  - a DRI interval of 0xFFFF makes the restart count loop forever (hang).
+// Exit code 0 means the file was accepted, 1 that it was rejected.
+//
+// Instrumented build:
+//   g++ -O2 -c runtime/coverage_rt.cpp runtime/forkserver_rt.cpp
+//   g++ -O1 -fsanitize-coverage=trace-pc,trace-cmp -o jpeg_target targets/jpeg_target.cpp coverage_rt.o forkserver_rt.o -ldl
+// As a library for the in-process executor:
+//   g++ -O2 -fPIC -c -o coverage_rt_pic.o runtime/coverage_rt.cpp
+//   g++ -O1 -fPIC -shared -fsanitize-coverage=trace-pc,trace-cmp -o jpeg_target.so targets/jpeg_target.cpp coverage_rt_pic.o
+#include <array>
+#include <cstdint>
+#include <cstdio>
+#include <vector>
+
+namespace {
+
+struct component {
+    uint8_t id;
+    uint8_t h;
+    uint8_t v;
+    uint8_t tq;
+};
+
+struct decoder {
+    uint16_t width = 0;
+    uint16_t height = 0;
+    std::vector<component> components;
+    uint16_t storage[4][64] = {};
+    uint16_t* quant[16] = { storage[0], storage[1], storage[2], storage[3] };
+    int huffmanTables = 0;
+    int restartInterval = 0;
+    bool frame = false;
+};
+
+uint16_t be16(const uint8_t* p) {
+    return static_cast<uint16_t>(p[0] << 8 | p[1]);
+}
+
+bool parseDQT(decoder& d, const uint8_t* p, size_t len) {
+    while (len > 0) {
+        int precision = p[0] >> 4;
+        int id = p[0] & 15;
+        size_t size = 1 + 64 * (precision ? 2 : 1);
+        if (precision > 1 || len < size)
+            return false;
+        for (int k = 0; k < 64; ++k)
+            d.quant[id][k] = precision ? be16(p + 1 + 2 * k) : p[1 + k];
+        p += size;
+        len -= size;
+    }
+    return true;
+}
+
+bool parseDHT(decoder& d, const uint8_t* p, size_t len) {
+    while (len > 0) {
+        if (len < 17 || (p[0] >> 4) > 1 || (p[0] & 15) > 3)
+            return false;
+        size_t total = 0;
+        for (int i = 1; i <= 16; ++i)
+            total += p[i];
+        if (len < 17 + total)
+            return false;
+        std::array<uint8_t, 256> symbols;
+        for (size_t i = 0; i < total; ++i)
+            symbols.at(i) = p[17 + i];
+        ++d.huffmanTables;
+        p += 17 + total;
+        len -= 17 + total;
+    }
+    return true;
+}
+
+bool parseSOF(decoder& d, const uint8_t* p, size_t len) {
+    if (len < 6 || p[0] != 8)
+        return false;
+    d.height = be16(p + 1);
+    d.width = be16(p + 3);
+    int count = p[5];
+    if (d.width == 0 || count == 0 || count > 4 || len < 6 + 3 * static_cast<size_t>(count))
+        return false;
+    d.components.clear();
+    for (int i = 0; i < count; ++i) {
+        const uint8_t* c = p + 6 + 3 * i;
+        if ((c[1] >> 4) == 0 || (c[1] >> 4) > 4 || (c[1] & 15) == 0 || (c[1] & 15) > 4 || c[2] > 3)
+            return false;
+        d.components.push_back({ c[0], static_cast<uint8_t>(c[1] >> 4), static_cast<uint8_t>(c[1] & 15), c[2] });
+    }
+    d.frame = true;
+    return true;
+}
+
+component* findComponent(decoder& d, uint8_t id) {
+    for (component& c : d.components)
+        if (c.id == id)
+            return &c;
+    return nullptr;
+}
+
+bool parseSOS(decoder& d, const uint8_t* p, size_t len) {
+    if (!d.frame || len < 1)
+        return false;
+    int count = p[0];
+    if (count == 0 || count > 4 || len < 4 + 2 * static_cast<size_t>(count))
+        return false;
+    if (d.huffmanTables == 0)
+        return false;
+    int blocks = 0;
+    for (int i = 0; i < count; ++i) {
+        component* c = findComponent(d, p[1 + 2 * i]);
+        blocks += c->h * c->v;
+    }
+    return blocks <= 10;
+}
+
+// Restart intervals in the scan; the 16-bit step wraps to 0 for an interval of 0xFFFF.
+int countRestarts(const decoder& d) {
+    size_t mcus = static_cast<size_t>((d.width + 7) / 8) * ((d.height + 7) / 8);
+    volatile int restarts = 0;
+    if (d.restartInterval)
+        for (size_t mcu = 0; mcu < mcus; mcu += static_cast<uint16_t>(d.restartInterval + 1))
+            restarts = restarts + 1;
+    return restarts;
+}
+
+int decode(const uint8_t* data, size_t size) {
+    if (size < 4 || data[0] != 0xFF || data[1] != 0xD8)
+        return 1;
+    decoder d;
+    size_t pos = 2;
+    while (pos + 2 <= size) {
+        if (data[pos] != 0xFF)
+            return 1;
+        uint8_t marker = data[pos + 1];
+        if (marker == 0xD9)
+            return d.frame ? 0 : 1;
+        if (pos + 4 > size)
+            return 1;
+        size_t len = be16(&data[pos + 2]);
+        if (len < 2 || pos + 2 + len > size)
+            return 1;
+        const uint8_t* body = &data[pos + 4];
+        size_t bodySize = len - 2;
+        bool ok = true;
+        switch (marker) {
+        case 0xDB:
+            ok = parseDQT(d, body, bodySize);
+            break;
+        case 0xC4:
+            ok = parseDHT(d, body, bodySize);
+            break;
+        case 0xC0:
+        case 0xC1:
+            ok = parseSOF(d, body, bodySize);
+            break;
+        case 0xDD:
+            ok = bodySize == 2;
+            d.restartInterval = bodySize == 2 ? be16(body) : 0;
+            break;
+        case 0xDA:
+            if (!parseSOS(d, body, bodySize) || countRestarts(d) > 0xFFFF)
+                return 1;
+            // Skip the entropy-coded data up to the next marker that is not a stuffed 0xFF00 or RSTn.
+            pos += 2 + len;
+            while (pos + 1 < size && !(data[pos] == 0xFF && data[pos + 1] != 0 && (data[pos + 1] < 0xD0 || data[pos + 1] > 0xD7)))
+                ++pos;
+            continue;
+        default:
+            ok = (marker >= 0xE0 && marker <= 0xEF) || marker == 0xFE;
+            break;
+        }
+        if (!ok)
+            return 1;
+        pos += 2 + len;
+    }
+    return 1;
+}
+
+}
+
+// Entry point for the fuzzer's in-process executor, see runtime/harness_host.cpp.
+extern "C" int fuzz_one(const uint8_t* data, size_t size) {
+    return decode(data, size);
+}
+
+int main(int argc, char** argv) {
+    if (argc < 2)
+        return 2;
+    std::FILE* f = std::fopen(argv[1], "rb");
+    if (!f)
+        return 2;
+    std::vector<uint8_t> data;
+    uint8_t chunk[4096];
+    size_t n;
+    while ((n = std::fread(chunk, 1, sizeof(chunk), f)) > 0)
+        data.insert(data.end(), chunk, chunk + n);
+    std::fclose(f);
+    return decode(data.data(), data.size());
+}
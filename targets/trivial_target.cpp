@@ -0,0 +1,21 @@
+// Target that only reads its input and exits, so a benchmark against it measures the cost
+// of starting and finishing a run rather than the code under test.
+//
+// Instrumented build:
+//   g++ -O2 -c runtime/coverage_rt.cpp runtime/forkserver_rt.cpp
+//   g++ -O1 -fsanitize-coverage=trace-pc -o trivial_target targets/trivial_target.cpp coverage_rt.o forkserver_rt.o -ldl
+#include <cstdio>
+
+int main(int argc, char** argv) {
+    if (argc < 2)
+        return 2;
+    std::FILE* f = std::fopen(argv[1], "rb");
+    if (!f)
+        return 2;
+    char chunk[4096];
+    size_t total = 0, n;
+    while ((n = std::fread(chunk, 1, sizeof(chunk), f)) > 0)
+        total += n;
+    std::fclose(f);
+    return total == 0;
+}